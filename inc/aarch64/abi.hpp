@@ -32,6 +32,7 @@ class Sys_abi
         auto       &p2() const { return s.gpr[2]; }
         auto const &p3() const { return s.gpr[3]; }
         auto const &p4() const { return s.gpr[4]; }
+        auto const &p5() const { return s.gpr[5]; }
 
         ALWAYS_INLINE uint8_t flags() const { return p0() >> 4 & BIT_RANGE (3, 0); }
 };
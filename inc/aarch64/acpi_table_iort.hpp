@@ -55,6 +55,57 @@ class Acpi_table_iort final
 
         static_assert (alignof (Node) == 1 && sizeof (Node) == 16);
 
+        /*
+         * Wired Interrupt
+         */
+        struct Irq
+        {
+            Unaligned_le<uint32_t>  gsiv;                       // 0
+            Unaligned_le<uint32_t>  flags;                      // 4
+        };
+
+        static_assert (alignof (Irq) == 1 && sizeof (Irq) == 8);
+
+        /*
+         * SMMUv1 or SMMUv2 Node
+         */
+        struct Node_smmu_v2 : public Node                       // 0
+        {
+            Unaligned_le<uint64_t>  base;                       // 16
+            Unaligned_le<uint64_t>  span;                       // 24
+            Unaligned_le<uint32_t>  model;                      // 32
+            Unaligned_le<uint32_t>  flags;                      // 36
+            Unaligned_le<uint32_t>  glb_ofs;                    // 40
+            Unaligned_le<uint32_t>  ctx_cnt;                    // 44
+            Unaligned_le<uint32_t>  ctx_ofs;                    // 48
+            Unaligned_le<uint32_t>  pmu_cnt;                    // 52
+            Unaligned_le<uint32_t>  pmu_ofs;                    // 56
+
+            void parse() const;
+        };
+
+        static_assert (alignof (Node_smmu_v2) == 1 && sizeof (Node_smmu_v2) == 60);
+
+        /*
+         * SMMUv3 Node
+         */
+        struct Node_smmu_v3 : public Node                       // 0
+        {
+            Unaligned_le<uint64_t>  base;                       // 16
+            Unaligned_le<uint32_t>  flags;                      // 24
+            Unaligned_le<uint32_t>  reserved;                   // 28
+            Unaligned_le<uint64_t>  vatos;                      // 32
+            Unaligned_le<uint32_t>  model;                      // 40
+            Unaligned_le<uint32_t>  gsiv_evt;                   // 44
+            Unaligned_le<uint32_t>  gsiv_pri;                   // 48
+            Unaligned_le<uint32_t>  gsiv_err;                   // 52
+            Unaligned_le<uint32_t>  gsiv_syn;                   // 56
+
+            void parse() const;
+        };
+
+        static_assert (alignof (Node_smmu_v3) == 1 && sizeof (Node_smmu_v3) == 60);
+
     public:
         void parse() const;
 };
@@ -46,6 +46,12 @@ class Cache final
             asm volatile ("dc cvac, %0; dsb sy" : : "r" (ptr) : "memory");
         }
 
+        ALWAYS_INLINE
+        static inline void data_clean_invalidate (void const *ptr)
+        {
+            asm volatile ("dc civac, %0; dsb sy" : : "r" (ptr) : "memory");
+        }
+
         ALWAYS_INLINE
         static inline void data_clean (void const *ptr, size_t size)
         {
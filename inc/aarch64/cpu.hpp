@@ -292,6 +292,7 @@ class Cpu final
         static unsigned         hazard      CPULOCAL;
         static bool             bsp         CPULOCAL;
         static uint64_t         gicr        CPULOCAL;
+        static uint32_t         uid         CPULOCAL;   // ACPI Processor UID
         static uint64_t         cptr        CPULOCAL;
         static uint64_t         mdcr        CPULOCAL;
 
@@ -309,6 +310,19 @@ class Cpu final
 
         static auto remote_ptab (cpu_t cpu) { return *Kmem::loc_to_glob (cpu, &ptab); }
 
+        /*
+         * Determine if all cores are online, which implies that CPU-local
+         * memory is mapped on every core
+         *
+         * @return  True if all cores are online, false otherwise
+         */
+        static bool all_online()
+        {
+            cpu_t const o { online };
+
+            return o && o == count;
+        }
+
         static void preemption_disable() { asm volatile ("msr daifset, #0xf" : : : "memory"); }
 
         static void preemption_enable() { asm volatile ("msr daifclr, #0xf" : : : "memory"); }
@@ -317,6 +331,8 @@ class Cpu final
 
         static void halt() { asm volatile ("wfi; msr daifclr, #0xf; msr daifset, #0xf" : : : "memory"); }
 
+        static bool irq_pending() { uint64_t v; asm volatile ("mrs %x0, isr_el1" : "=r" (v)); return v & (BIT (7) | BIT (6)); }
+
         [[nodiscard]] static uint8_t feature (Cpu_feature f) { return feat_cpu64[std::to_underlying (f) / 16] >> std::to_underlying (f) % 16 * 4 & BIT_RANGE (3, 0); }
         [[nodiscard]] static uint8_t feature (Dbg_feature f) { return feat_dbg64[std::to_underlying (f) / 16] >> std::to_underlying (f) % 16 * 4 & BIT_RANGE (3, 0); }
         [[nodiscard]] static uint8_t feature (Isa_feature f) { return feat_isa64[std::to_underlying (f) / 16] >> std::to_underlying (f) % 16 * 4 & BIT_RANGE (3, 0); }
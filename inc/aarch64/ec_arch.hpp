@@ -18,14 +18,17 @@
 #pragma once
 
 #include "assert.hpp"
+#include "barrier.hpp"
 #include "ec.hpp"
 #include "extern.hpp"
 #include "mtd.hpp"
 #include "utcb.hpp"
+#include "vmcb.hpp"
 
 class Ec_arch final : private Ec
 {
     friend class Ec;
+    friend class Timeout_vtimer;
 
     private:
         static constexpr auto needs_pio { false };
@@ -64,6 +67,9 @@ class Ec_arch final : private Ec
         [[noreturn]]
         static void ret_user_vmexit (Ec *);
 
+        [[noreturn]]
+        static void ret_user_wfi (Ec *);
+
         [[noreturn]]
         static void set_vmm_regs (Ec *);
 
@@ -83,6 +89,20 @@ class Ec_arch final : private Ec
             return self->get_utcb()->arch()->save (mtd, cpu_regs(), self->regs.get_obj());
         }
 
+        /*
+         * Prepare the EC for execution on the current CPU
+         *
+         * @return      True (the host space is shared by all CPUs)
+         */
+        ALWAYS_INLINE
+        inline bool prepare_cpu() { return true; }
+
+        Status post_vint (unsigned, uint8_t);
+
+        static void handle_wfi (Ec *);
+
+        void wake_wfi();
+
         [[noreturn]] ALWAYS_INLINE
         inline void make_current()
         {
@@ -91,8 +111,20 @@ class Ec_arch final : private Ec
             // Reset stack
             asm volatile ("adrp %0, %1; mov sp, %0" : "=&r" (dummy) : "S" (&DSTK_TOP) : "memory");
 
+            if (current != this) {
+
+                // Assign the FPU ahead of its first use if the FPU policy says so
+                fpu_prefetch (current);
+
+                current = this;
+
+                // Order the store to current before the check for posted virtual interrupts (pairs with Vmcb::post)
+                if (is_vcpu())
+                    Barrier::fmb (Barrier::Domain::ISH);
+            }
+
             // Become current EC and invoke continuation
-            (*cont)(current = this);
+            (*cont)(this);
 
             UNREACHED;
         }
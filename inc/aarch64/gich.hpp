@@ -87,12 +87,23 @@ class Gich final
         static void init_mmio();
         static void init_regs();
 
+        static uint64_t get_lr (unsigned);
+        static void set_lr (unsigned, uint64_t);
+
     public:
         static unsigned num_apr CPULOCAL;
         static unsigned num_lr  CPULOCAL;
 
+        static inline constinit unsigned ppi_mnt { 9 };     // Maintenance interrupt
+
         static void init();
 
+        static bool inject (unsigned, uint8_t, bool = false);
+
+        static bool pending();
+
+        static void set_uie (bool);
+
         static void disable()
         {
             if (Gicc::mode == Gicc::Mode::REGS) {
@@ -56,6 +56,7 @@ class Interrupt final : private Intid
         {
             RRQ,
             RKE,
+            RCL,
         };
 
         Sm *            sm      { nullptr };
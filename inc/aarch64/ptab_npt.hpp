@@ -90,7 +90,7 @@ class Nptp final : public Ptab<Npt, uint64_t, uint64_t>
         Nptp() : Ptab { Npt { 0 } } {}
 
         ALWAYS_INLINE
-        inline void make_current (Vmid vmid) const
+        inline void make_current (uint16_t vmid) const
         {
             auto const vttbr { static_cast<uint64_t>(vmid) << 48 | root_addr() };
 
@@ -99,7 +99,7 @@ class Nptp final : public Ptab<Npt, uint64_t, uint64_t>
         }
 
         ALWAYS_INLINE
-        inline void invalidate (Vmid vmid) const
+        inline void invalidate (uint16_t vmid) const
         {
             make_current (vmid);
 
@@ -30,6 +30,29 @@ class Space_dma;
 
 class Smmu final : public List<Smmu>
 {
+    public:
+        enum class Arch : unsigned
+        {
+            SMMUv2,                 // Stream Mapping Groups and Context Banks
+            SMMUv3,                 // Stream Table and Command/Event Queues
+        };
+
+        /*
+         * SMMU Description (from the board or from the ACPI IORT)
+         *
+         * SMMUv2: Global fault and context fault interrupts
+         * SMMUv3: Event queue and global error interrupts
+         */
+        struct Desc
+        {
+            struct Irq { unsigned spi, flg; };
+
+            uint64_t    mmio    { 0 };
+            Arch        arch    { Arch::SMMUv2 };
+            Irq         glb[2]  { };
+            Irq         ctx[64] { };
+        };
+
     private:
         struct Config
         {
@@ -149,8 +172,70 @@ class Smmu final : public List<Smmu>
             ATS1UW      = 0x818,    // s1 -- -w Address Translation Stage 1, Unprivileged Write
         };
 
-        uintptr_t           mmio_base_gr0   { 0 };              // Global Register Space 0
-        uintptr_t           mmio_base_gr1   { 0 };              // Global Register Space 1
+        /*
+         * SMMUv3 Register Page 0
+         */
+        enum class V3_Reg32 : unsigned
+        {
+            IDR0        = 0x000,    // r- Identification Register 0
+            IDR1        = 0x004,    // r- Identification Register 1
+            IDR2        = 0x008,    // r- Identification Register 2
+            IDR3        = 0x00c,    // r- Identification Register 3
+            IDR4        = 0x010,    // r- Identification Register 4
+            IDR5        = 0x014,    // r- Identification Register 5
+            IIDR        = 0x018,    // r- Implementation Identification Register
+            AIDR        = 0x01c,    // r- Architecture Identification Register
+            CR0         = 0x020,    // rw Control Register 0
+            CR0ACK      = 0x024,    // r- Control Register 0 Update Acknowledge
+            CR1         = 0x028,    // rw Control Register 1
+            CR2         = 0x02c,    // rw Control Register 2
+            STATUSR     = 0x040,    // r- Status Register
+            GBPA        = 0x044,    // rw Global Bypass Attribute
+            IRQ_CTRL    = 0x050,    // rw Interrupt Control Register
+            IRQ_CTRLACK = 0x054,    // r- Interrupt Control Register Update Acknowledge
+            GERROR      = 0x060,    // r- Global Error Status
+            GERRORN     = 0x064,    // rw Global Error Acknowledge
+            STRTAB_CFG  = 0x088,    // rw Stream Table Base Configuration
+            CMDQ_PROD   = 0x098,    // rw Command Queue Producer Index
+            CMDQ_CONS   = 0x09c,    // rw Command Queue Consumer Index
+        };
+
+        enum class V3_Reg64 : unsigned
+        {
+            STRTAB_BASE = 0x080,    // rw Stream Table Base Address
+            CMDQ_BASE   = 0x090,    // rw Command Queue Base Address
+            EVTQ_BASE   = 0x0a0,    // rw Event Queue Base Address
+        };
+
+        /*
+         * SMMUv3 Register Page 1
+         */
+        enum class V3_Pg1_32 : unsigned
+        {
+            EVTQ_PROD   = 0x0a8,    // rw Event Queue Producer Index
+            EVTQ_CONS   = 0x0ac,    // rw Event Queue Consumer Index
+        };
+
+        /*
+         * SMMUv3 Command Opcodes
+         */
+        enum class Cmd : uint8_t
+        {
+            CFGI_STE        = 0x03, // Invalidate STE
+            CFGI_ALL        = 0x04, // Invalidate all STEs
+            TLBI_S12_VMALL  = 0x28, // Invalidate all entries of a VMID
+            TLBI_S2_IPA     = 0x2a, // Invalidate stage-2 entries by IPA
+            TLBI_NSNH_ALL   = 0x30, // Invalidate all non-secure non-hyp entries
+            SYNC            = 0x46, // Complete all prior commands
+        };
+
+        static constexpr unsigned strtab_split  { 6 };  // SID bits resolved by a 4KiB level-2 stream table
+        static constexpr unsigned ipa_ord_page  { 4 };  // Largest range (order) invalidated page by page
+        static constexpr unsigned ipa_ord_range { 9 };  // Largest range (order) invalidated by one range command
+        static constexpr unsigned timeout       { 10 }; // Command completion timeout (ms)
+
+        uintptr_t           mmio_base_gr0   { 0 };              // Global Register Space 0 (v3: Page 0)
+        uintptr_t           mmio_base_gr1   { 0 };              // Global Register Space 1 (v3: Page 1)
         uintptr_t           mmio_base_ctx   { 0 };              // Translation Context Bank Space
         unsigned            page_size       { 0 };              // 4KiB or 64KiB
         unsigned            sidx_bits       { 0 };              // Stream ID Bits
@@ -159,8 +244,19 @@ class Smmu final : public List<Smmu>
         uint8_t             ias             { 0 };              // IAddr Size
         uint8_t             oas             { 0 };              // OAddr Size
         Mode                mode            { 0 };              // SMMU Mode
+        Arch                arch            { 0 };              // SMMU Architecture
+        bool                strtab_2lvl     { false };          // v3: 2-Level Stream Table
+        bool                ril             { false };          // v3: Range Invalidation
+        bool                ready           { false };          // v3: Command Queue Operational
+        uint8_t             cmdq_bits       { 0 };              // v3: Command Queue Size (log2)
+        uint8_t             evtq_bits       { 0 };              // v3: Event Queue Size (log2)
+        uint64_t            cmdq_tail       { 0 };              // v3: Command Queue Entries Written
+        uint64_t            cmdq_prod       { 0 };              // v3: Command Queue Entries Published
+        uint64_t *          strtab          { nullptr };        // v3: Stream Table (Linear or Level 1)
+        uint64_t *          cmdq            { nullptr };        // v3: Command Queue
+        uint64_t *          evtq            { nullptr };        // v3: Event Queue
         Config *            config          { nullptr };        // Configuration Table Pointer
-        Board::Smmu const & board;                              // SMMU Board Setup
+        Desc const          desc;                               // SMMU Description
         Spinlock            cfg_lock;                           // SMMU CFG Lock
         Spinlock            inv_lock;                           // SMMU INV Lock
 
@@ -182,10 +278,21 @@ class Smmu final : public List<Smmu>
         inline void write (unsigned ctx, Ctx_Arr32 r, uint32_t v) { *reinterpret_cast<uint32_t volatile *>(mmio_base_ctx + ctx * page_size         + std::to_underlying (r)) = v; }
         inline void write (unsigned ctx, Ctx_Arr64 r, uint64_t v) { *reinterpret_cast<uint64_t volatile *>(mmio_base_ctx + ctx * page_size         + std::to_underlying (r)) = v; }
 
+        inline auto read  (V3_Reg32  r)             { return *reinterpret_cast<uint32_t volatile *>(mmio_base_gr0 + std::to_underlying (r)); }
+        inline auto read  (V3_Reg64  r)             { return *reinterpret_cast<uint64_t volatile *>(mmio_base_gr0 + std::to_underlying (r)); }
+        inline auto read  (V3_Pg1_32 r)             { return *reinterpret_cast<uint32_t volatile *>(mmio_base_gr1 + std::to_underlying (r)); }
+
+        inline void write (V3_Reg32  r, uint32_t v) { *reinterpret_cast<uint32_t volatile *>(mmio_base_gr0 + std::to_underlying (r)) = v; }
+        inline void write (V3_Reg64  r, uint64_t v) { *reinterpret_cast<uint64_t volatile *>(mmio_base_gr0 + std::to_underlying (r)) = v; }
+        inline void write (V3_Pg1_32 r, uint32_t v) { *reinterpret_cast<uint32_t volatile *>(mmio_base_gr1 + std::to_underlying (r)) = v; }
+
+        // Size of the linear or level-1 stream table (64-byte STEs or 8-byte L1STDs)
+        inline size_t strtab_size() const { return strtab_2lvl ? BITN (sidx_bits - strtab_split + 3) : BITN (sidx_bits + 6); }
+
         inline bool glb_spi (unsigned spi) const
         {
-            for (unsigned i { 0 }; i < sizeof (board.glb) / sizeof (*board.glb); i++)
-                if (board.glb[i].flg && board.glb[i].spi == spi)
+            for (unsigned i { 0 }; i < sizeof (desc.glb) / sizeof (*desc.glb); i++)
+                if (desc.glb[i].flg && desc.glb[i].spi == spi)
                     return true;
 
             return false;
@@ -193,8 +300,8 @@ class Smmu final : public List<Smmu>
 
         inline bool ctx_spi (unsigned spi) const
         {
-            for (unsigned i { 0 }; i < sizeof (board.ctx) / sizeof (*board.ctx); i++)
-                if (board.ctx[i].flg && board.ctx[i].spi == spi)
+            for (unsigned i { 0 }; i < sizeof (desc.ctx) / sizeof (*desc.ctx); i++)
+                if (desc.ctx[i].flg && desc.ctx[i].spi == spi)
                     return true;
 
             return false;
@@ -209,8 +316,26 @@ class Smmu final : public List<Smmu>
         void tlb_sync_ctx (unsigned);
         void tlb_sync_glb();
 
+        void tlb_invalidate_post (Sdid, uint64_t, unsigned);
+        void tlb_wait();
+
+        void probe_v3();
+        void init_v3();
+        void fault_v3();
+
+        bool conf_ste (uint16_t, Space_dma *);
+        uint64_t *ste (uint16_t);
+
+        void cmd_post (Cmd, uint64_t = 0, uint64_t = 0);
+        void cmd_publish();
+        void cmd_sync();
+        [[nodiscard]] bool cmd_wait();
+        uint64_t cmd_cons();
+
     public:
-        explicit Smmu (Board::Smmu const &);
+        explicit Smmu (Desc const &);
+
+        static Desc describe (Board::Smmu const &);
 
         bool conf_smg (uint8_t);
 
@@ -220,22 +345,34 @@ class Smmu final : public List<Smmu>
         static inline uint8_t avail_smg() { return list ? list->num_smg : 0; }
         static inline uint8_t avail_ctx() { return list ? list->num_ctx : 0; }
 
+        static inline bool present() { return list; }
+
         static inline void initialize()
         {
             for (auto smmu { list }; smmu; smmu = smmu->next)
                 smmu->init();
         }
 
-        static inline void tlb_invalidate_all (Sdid s)
+        /*
+         * TLB Invalidation of a DMA range on all SMMUs
+         *
+         * @param s     Domain
+         * @param a     Address of the range
+         * @param o     Order of the range (in pages)
+         */
+        static inline void tlb_invalidate_all (Sdid s, uint64_t a, unsigned o)
         {
             for (auto smmu { list }; smmu; smmu = smmu->next)
-                smmu->tlb_invalidate (s);
+                smmu->tlb_invalidate_post (s, a, o);
+
+            for (auto smmu { list }; smmu; smmu = smmu->next)
+                smmu->tlb_wait();
         }
 
         static inline Smmu *lookup (Hpt::OAddr p)
         {
             for (auto smmu { list }; smmu; smmu = smmu->next)
-                if (smmu->board.mmio == p)
+                if (smmu->desc.mmio == p)
                     return smmu;
 
             return nullptr;
@@ -81,7 +81,7 @@ class Space_dma final : public Space_mem<Space_dma>
 
         auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return dptp.update (v, p, o, pm, ma); }
 
-        void sync() { Smmu::tlb_invalidate_all (sdid); }
+        void sync (uint64_t v, unsigned o) { Smmu::tlb_invalidate_all (sdid, v, o); }
 
         auto get_sdid() const { return sdid; }
 };
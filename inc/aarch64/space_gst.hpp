@@ -23,7 +23,7 @@
 class Space_gst final : public Space_mem<Space_gst>
 {
     private:
-        Vmid const  vmid;
+        Vmid        vmid;
         Nptp        nptp;
 
         Space_gst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::GST, p } {}
@@ -78,7 +78,7 @@ class Space_gst final : public Space_mem<Space_gst>
 
         auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return nptp.update (v, p, o, pm, ma); }
 
-        void sync() { nptp.invalidate (vmid); }
+        void sync (uint64_t, unsigned) { nptp.invalidate (vmid.get()); }
 
-        void make_current() { nptp.make_current (vmid); }
+        void make_current() { nptp.make_current (vmid.get()); }
 };
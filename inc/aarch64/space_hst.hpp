@@ -23,7 +23,7 @@
 class Space_hst final : public Space_mem<Space_hst>
 {
     private:
-        Vmid const  vmid;
+        Vmid        vmid;
         Nptp        nptp;
 
         Space_hst();
@@ -84,9 +84,9 @@ class Space_hst final : public Space_mem<Space_hst>
 
         auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return nptp.update (v, p, o, pm, ma); }
 
-        void sync() { nptp.invalidate (vmid); }
+        void sync (uint64_t, unsigned) { nptp.invalidate (vmid.get()); }
 
-        void make_current() { nptp.make_current (vmid); }
+        void make_current() { nptp.make_current (vmid.get()); }
 
         static void access_ctrl (uint64_t phys, size_t size, Paging::Permissions perm) { Space_mem::access_ctrl (nova, phys, size, perm, Memattr::dev()); }
 };
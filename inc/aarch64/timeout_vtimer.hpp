@@ -0,0 +1,38 @@
+/*
+ * Virtual Timer Timeout
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "timeout.hpp"
+
+class Ec_arch;
+
+/*
+ * Wakes a vCPU that blocked in WFI when its virtual timer expires
+ */
+class Timeout_vtimer final : public Timeout
+{
+    private:
+        Ec_arch *   ec  { nullptr };
+
+        void trigger() override;
+
+    public:
+        void set_ec (Ec_arch *e) { ec = e; }
+
+        bool wakes (Ec_arch const *e) const { return ec == e; }
+};
@@ -17,8 +17,10 @@
 
 #pragma once
 
+#include "atomic.hpp"
 #include "buddy.hpp"
 #include "interrupt.hpp"
+#include "timeout_vtimer.hpp"
 #include "types.hpp"
 
 class Vmcb final
@@ -84,7 +86,38 @@ class Vmcb final
             uint32_t    hcr         { BIT (0) };    // Hypervisor Control Register
         } gic;
 
-        static Vmcb const *current CPULOCAL;
+        static constexpr auto num_vint { Intid::NUM_SGI + Intid::NUM_PPI + Intid::NUM_SPI };
+
+        bool             vtm        { false };      // Virtual timer interrupts are delivered by NOVA
+        bool             hpl        { false };      // WFI polls before blocking
+        Atomic<uint32_t> wfi        { 0 };          // vCPU is blocked in WFI
+        Timeout_vtimer   timeout;                   // Virtual timer deadline of a vCPU blocked in WFI
+        uint64_t         poll       { 0 };          // Halt-polling window in ticks
+        uint64_t         halt       { 0 };          // Start of the current WFI block
+
+    private:
+        uint64_t        tag { 0 };                  // Context tag of the last full register load on the vCPU's CPU
+
+        Atomic<uint64_t> vint_pend[(num_vint + 63) / 64];   // Posted vINTIDs
+        Atomic<uint32_t> vint_word { 0 };                   // Words of vint_pend with posted vINTIDs
+
+        static constexpr uint8_t tmr_prio { 0xa0 };         // Priority of the virtual timer interrupt
+
+        static constexpr uint32_t poll_min_us {  10 };      // Initial halt-polling window
+        static constexpr uint32_t poll_max_us { 200 };      // Maximum halt-polling window
+        uint8_t          vint_prio[num_vint];               // Priorities of posted vINTIDs
+
+        static uint64_t ctx     CPULOCAL;           // Context tag of the EL1 state in the registers
+        static Vmcb *   stale   CPULOCAL;           // VMCB whose state in memory is older than the registers
+        static bool     guest   CPULOCAL;           // EL2 configuration is set up for the VMCB of the EL1 state
+
+        void load_el1() const;
+        void load_cfg() const;
+        void save_el1();
+        void save_cfg();
+        void inject();
+
+    public:
 
         ALWAYS_INLINE
         inline void save_tmr()
@@ -101,8 +134,63 @@ class Vmcb final
         static void init();
         static void load_hst();
 
-        void load_gst() const;
-        void save_gst();
+        void make_current();
+
+        /*
+         * Check if the EL2 configuration is set up for a guest
+         *
+         * @return      True if the host EL2 configuration must be loaded before returning to host EL0
+         */
+        static bool gst_active() { return guest; }
+
+        /*
+         * Write back register state that is newer than its VMCB
+         *
+         * Host ECs do not use the EL1 state, so it stays in the registers until another
+         * vCPU loads its state, the UTCB transfer reads it, or the CPU enters a sleep state.
+         */
+        static void sync()
+        {
+            if (EXPECT_FALSE (stale)) {
+                if (guest)
+                    stale->save_cfg();
+                stale->save_el1();
+                stale = nullptr;
+            }
+        }
+
+        /*
+         * Discard register state after the VMCB has been updated
+         *
+         * @param full  True if EL1 state was updated, false if only EL2 configuration, timer or GIC state was updated
+         */
+        void invalidate (bool full)
+        {
+            if (tag != ctx)
+                return;
+
+            guest = false;
+
+            if (full)
+                tag = 0;
+        }
+
+        void adjust_cntvoff (uint64_t);
+
+        bool post (unsigned, uint8_t);
+
+        /*
+         * Check if virtual interrupts are posted
+         *
+         * @return      True if the next guest entry injects virtual interrupts, false otherwise
+         */
+        bool pending() const { return vint_word; }
+
+        bool inject_tmr();
+
+        bool wfi_block (uint64_t &) const;
+
+        void adapt_poll (uint64_t);
 
         /*
          * Allocate VMCB
@@ -115,6 +203,17 @@ class Vmcb final
             return Buddy::alloc (0);
         }
 
+        /*
+         * Allocate VMCB on a specific node
+         *
+         * @param node  Preferred NUMA node
+         * @return      Pointer to the VMCB (allocation success) or nullptr (allocation failure)
+         */
+        [[nodiscard]] static void *operator new (size_t, Numa::node_t node) noexcept
+        {
+            return Buddy::alloc (0, Buddy::Fill::NONE, node);
+        }
+
         /*
          * Deallocate VMCB
          *
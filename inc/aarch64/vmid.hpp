@@ -18,24 +18,55 @@
 #pragma once
 
 #include "atomic.hpp"
+#include "compiler.hpp"
 #include "macros.hpp"
+#include "spinlock.hpp"
 #include "types.hpp"
 
+/*
+ * VMIDs are shared by all CPUs, because stage-2 TLB maintenance is broadcast.
+ * A VMID is assigned lazily and tagged with the generation in which it was
+ * assigned. When all VMIDs are in use, a new generation starts and the TLBs
+ * of all VMIDs are flushed. VMIDs that are active on some CPU at that time
+ * remain reserved for their owners.
+ */
 class Vmid final
 {
     private:
-        uint16_t const val;
+        static constexpr unsigned gen_shift { 16 };
+
+        Atomic<uint64_t> tag { 0 };                                     // Generation | VMID
+
+        static inline constinit unsigned bits { 16 };                   // VMID Width
+        static inline constinit uint16_t next { 1 };                    // Next VMID to Consider
+        static inline constinit Atomic<uint64_t> gen { BIT64 (gen_shift) };
+        static inline constinit Spinlock lock;                          // Allocator Spinlock
 
-        static inline constinit Atomic<uint16_t> allocator { 0 };
+        static uint64_t map[BIT (gen_shift) / 64];                      // VMIDs in Use (Current Generation)
+        static Atomic<uint64_t> active CPULOCAL;                        // VMID Active on this Core
+        static uint64_t reserved CPULOCAL;                              // VMID Reserved across a Rollover
 
-        // FIXME: Handle overflow
-        static auto alloc()
+        static bool tas (uint16_t v)
         {
-            return allocator++;
+            auto const b { BIT64 (v % 64) };
+            auto const r { map[v / 64] & b };
+
+            map[v / 64] |= b;
+
+            return r;
         }
 
+        static uint16_t find (uint16_t);
+        static uint64_t alloc (uint64_t);
+        static void rollover();
+
     public:
-        Vmid() : val { alloc() } {}
+        uint16_t get();
+
+        /*
+         * Restrict VMIDs to 8 bits (must be called before the first VMID is assigned)
+         */
+        static void narrow() { bits = 8; }
 
-        operator auto() const { return val & BIT_RANGE (7, 0); }
+        static bool wide() { return bits == 16; }
 };
@@ -38,6 +38,7 @@ class Acpi_table_srat final
                 LAPIC   = 0,                                    // Local APIC
                 MEMORY  = 1,                                    // Memory
                 X2APIC  = 2,                                    // Local x2APIC
+                GICC    = 3,                                    // GICC
             };
 
             auto type() const { return Type { uint8_t { *this } }; }
@@ -97,6 +98,23 @@ class Acpi_table_srat final
 
         static_assert (alignof (Affinity_x2apic) == 1 && sizeof (Affinity_x2apic) == 24);
 
+        /*
+         * 5.2.16.4: GICC Affinity Structure
+         */
+        struct Affinity_gicc final : public Affinity            // 0
+        {
+            Unaligned_le<uint32_t>  pxd;                        // 2
+            Unaligned_le<uint32_t>  uid;                        // 6
+            Unaligned_le<uint32_t>  flags;                      // 10
+            Unaligned_le<uint32_t>  clock;                      // 14
+
+            void parse() const;
+        };
+
+        static_assert (alignof (Affinity_gicc) == 1 && sizeof (Affinity_gicc) == 18);
+
+        static void affinity (apic_t, uint32_t);
+
     public:
         void parse() const;
 };
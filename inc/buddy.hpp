@@ -22,7 +22,9 @@
 #pragma once
 
 #include "arch.hpp"
+#include "atomic.hpp"
 #include "memory.hpp"
+#include "numa.hpp"
 #include "queue.hpp"
 #include "spinlock.hpp"
 
@@ -44,8 +46,9 @@ class Buddy final
                     FREE,
                 };
 
-                order_t ord { 0 };
-                Tag     tag { Tag::USED };
+                order_t         ord  { 0 };
+                Tag             tag  { Tag::USED };
+                Numa::node_t    node { 0 };
         };
 
         class Freelist final
@@ -69,14 +72,36 @@ class Buddy final
                 auto dequeue()          { return list.dequeue_head(); }
         };
 
+        class Cachelist final
+        {
+            private:
+                Queue<Block>    list;
+                unsigned        size { 0 };
+
+            public:
+                static constexpr unsigned batch { 16 };     // Blocks moved per refill/drain
+                static constexpr unsigned limit { 64 };     // Drain watermark
+                static constexpr unsigned zeros { 32 };     // Pre-zeroed watermark
+
+                auto count() const      { return size; }
+
+                void enqueue (Block *b) { list.enqueue_head (b); size++; }
+                auto dequeue()          { auto const b { list.dequeue_head() }; if (b) size--; return b; }
+        };
+
         static inline constinit Spinlock    lock;       // Allocator Spinlock
         static inline constinit index_t     min_idx;    // Minimum Block Index
         static inline constinit index_t     max_idx;    // Maximum Block Index
         static inline constinit uintptr_t   mem_base;   // Base of Memory Pool
         static inline constinit Block *     blk_base;   // Base of Block Array
-        static inline constinit Freelist    freelist;   // Block Freelist
+        static inline constinit Freelist    freelist[Numa::nodes];  // Block Freelist (per Node)
+        static inline constinit Atomic<unsigned> pressure  { 0 };   // Memory Pressure Generation
+        static inline constinit Atomic<unsigned> reclaimed { 0 };   // Memory Pressure Generation Reclaimed
 
-        static Waitlist waitlist CPULOCAL;              // Block Waitlist (per Core)
+        static Waitlist  waitlist  CPULOCAL;            // Block Waitlist (per Core)
+        static Cachelist cachelist CPULOCAL;            // Order-0 Block Cache (per Core)
+        static Cachelist zerolist  CPULOCAL;            // Order-0 Pre-Zeroed Block Cache (per Core)
+        static unsigned  flushed   CPULOCAL;            // Memory Pressure Generation Flushed (per Core)
 
         static bool valid (index_t x) { return x >= min_idx && x < max_idx; }
 
@@ -86,7 +111,14 @@ class Buddy final
         static auto index_to_page (index_t x)   { return mem_base + x * PAGE_SIZE (0); }
         static auto page_to_index (uintptr_t x) { return static_cast<index_t>((x - mem_base) / PAGE_SIZE (0)); }
 
+        static Block *split (order_t, Numa::node_t, bool);
+        static Block *refill();
+
         NONNULL static void coalesce (Block *);
+        NONNULL static void release (Block *);
+        static void drain();
+        static bool flush();
+        static void count_lock();
 
     public:
         enum class Fill
@@ -97,11 +129,15 @@ class Buddy final
         };
 
         static void init();
+        static void rezone();
 
-        [[nodiscard]] static void *alloc (order_t, Fill = Fill::NONE);
+        [[nodiscard]] static void *alloc (order_t, Fill = Fill::NONE, Numa::node_t = Numa::local);
 
         static void free (void *);
         static void wait (void *);
 
-        static void free_wait() { for (Block *b; (b = waitlist.dequeue()); coalesce (b)); }
+        static bool prezero();
+        static bool relieve();
+
+        static void free_wait() { for (Block *b; (b = waitlist.dequeue()); release (b)); }
 };
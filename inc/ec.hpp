@@ -41,25 +41,69 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
     friend class Ec_arch;
     friend class Tlb;
 
+    public:
+        // FPU Switching Policy
+        enum class Fpu_mode : uint8_t
+        {
+            LAZY,                       // Switch on first FPU use (#NM)
+            EAGER,                      // Switch when the EC becomes current
+            ADAPTIVE,                   // Switch eagerly after repeated FPU use
+        };
+
     private:
         using cont_t = void (*)(Ec *);  // Continuation Type
 
+        // Cross-Core Claim Request
+        class Claim final : public Queue<Claim>::Element
+        {
+            public:
+                Ec *            ec      { nullptr };    // Handler EC
+                cpu_t           cpu     { 0 };          // Claiming CPU
+                bool            grant   { false };      // Claim granted
+                Atomic<bool>    done    { false };      // Claim processed
+        };
+
+        // Cross-Core Claim Queue
+        class Claims final
+        {
+            private:
+                Queue<Claim>    queue;
+                Spinlock        lock;
+
+            public:
+                void enqueue (Claim *, cpu_t);
+                auto dequeue();
+        };
+
         Cpu_regs            regs;
         unsigned long const evt;
         cpu_t         const cpu;
-        Fpu *         const fpu;
+        Fpu *               fpu;
+        Fpu_mode            fpm         { Fpu_mode::LAZY };
+        uint8_t             fpu_use     { 0 };
+        bool                fpu_pre     { false };
         void *        const kpage;
         Ec *                callee      { nullptr };
         Ec *                caller      { nullptr };
         Atomic<cont_t>      cont        { nullptr };
+        Atomic<cpu_t>       xcpu        { cpu };
+        uint64_t            xtime       { 0 };
         Timeout_hypercall   timeout     { this };
         Spinlock            lock;
 
         static Atomic<Ec *> current asm ("current") CPULOCAL;
         static Ec *         fpowner                 CPULOCAL;
         static unsigned     donations               CPULOCAL;
+        static Claim        claim                   CPULOCAL;
+        static Claims       claims                  CPULOCAL;
         static Slab_cache   cache;
 
+        // Number of consecutive runs with FPU use before ADAPTIVE switches eagerly
+        static constexpr uint8_t fpu_eager { 5 };
+
+        // FPU use count when ADAPTIVE switches eagerly, which decays by one per eager run
+        static constexpr uint8_t fpu_hold  { 16 };
+
         ALWAYS_INLINE inline auto &cpu_regs() { return regs; }
         ALWAYS_INLINE inline auto &exc_regs() { return regs.exc; }
         ALWAYS_INLINE inline auto &sys_regs() { return regs.exc.sys; }
@@ -88,18 +132,26 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         void fpu_load();
         void fpu_save();
 
+        void fpu_prefetch (Ec *);
+
         NOINLINE
         void handle_hazard (unsigned, cont_t);
 
         NOINLINE
         void help (Ec *, cont_t);
 
+        NOINLINE
+        Status acquire (Ec *);
+
         ALWAYS_INLINE
-        inline void rendezvous (Ec *, cont_t, cont_t, uintptr_t, uintptr_t, uintptr_t);
+        inline Status rendezvous (Ec *, cont_t, cont_t, uintptr_t, uintptr_t, uintptr_t);
 
         [[noreturn]] HOT
         void reply (cont_t = nullptr);
 
+        [[noreturn]] NOINLINE
+        void release (cont_t);
+
         [[noreturn]]
         void kill (char const *);
 
@@ -109,6 +161,9 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         [[noreturn]]
         static void blocking (Ec *self) { self->kill ("Blocking"); }
 
+        [[noreturn]]
+        static void claimed (Ec *self) { self->kill ("Claimed"); }
+
         [[noreturn]]
         static void idle (Ec *);
 
@@ -177,15 +232,18 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         // Constructor: GST EC
         template<typename T> Ec (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, T *v, void *k, cpu_t c, unsigned long e, cont_t x) : Kobject (Kobject::Type::EC, t ? Kobject::Subtype::EC_VCPU_OFFS : Kobject::Subtype::EC_VCPU_REAL), regs (ref_obj, ref_hst, v), evt (e), cpu (c), fpu (f), kpage (k), cont (x) {}
 
+        // Destructor
+        ~Ec();
+
     public:
         // Factory: Kernel Thread
         [[nodiscard]] static Ec *create (cpu_t, cont_t);
 
         // Factory: HST EC
-        [[nodiscard]] static Ec *create_hst (Status &s, Pd *, bool, bool, cpu_t, unsigned long, uintptr_t, uintptr_t);
+        [[nodiscard]] static Ec *create_hst (Status &s, Pd *, bool, bool, Fpu_mode, cpu_t, unsigned long, uintptr_t, uintptr_t);
 
         // Factory: GST EC
-        [[nodiscard]] static Ec *create_gst (Status &s, Pd *, bool, bool, cpu_t, unsigned long, uintptr_t, uintptr_t);
+        [[nodiscard]] static Ec *create_gst (Status &s, Pd *, bool, bool, Fpu_mode, bool, bool, bool, cpu_t, unsigned long, uintptr_t, uintptr_t);
 
         void destroy()
         {
@@ -197,7 +255,9 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         static void create_idle();
         static void create_root();
 
-        static bool switch_fpu (Ec *);
+        static void handle_claims();
+
+        static bool switch_fpu (Ec *, bool = false);
 
         ALWAYS_INLINE
         static inline Ec *remote_current (cpu_t cpu)
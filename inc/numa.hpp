@@ -0,0 +1,54 @@
+/*
+ * Non-Uniform Memory Access (NUMA)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "compiler.hpp"
+#include "types.hpp"
+
+class Numa final
+{
+    public:
+        using node_t = uint8_t;
+
+        static constexpr node_t nodes { 8 };            // Maximum Number of Nodes
+        static constexpr node_t local { 0xff };         // Node of the Current Core
+
+        static node_t node CPULOCAL;                    // Node of the Current Core
+
+    private:
+        struct Range
+        {
+            uint64_t    base;
+            uint64_t    size;
+            node_t      node;
+        };
+
+        static constexpr unsigned max_ranges { 32 };
+
+        static inline constinit uint32_t    domain[nodes]       { 0 };  // Proximity Domain of each Node
+        static inline constinit node_t      count               { 0 };  // Number of Nodes
+        static inline constinit Range       range[max_ranges]   { };    // Memory Ranges
+        static inline constinit unsigned    ranges              { 0 };  // Number of Memory Ranges
+
+    public:
+        static node_t lookup (uint32_t);
+        static node_t remote (cpu_t);
+        static node_t memory (uint64_t);
+
+        static void add_memory (uint64_t, uint64_t, uint32_t);
+};
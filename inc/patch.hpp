@@ -39,6 +39,26 @@
                         .word T;                                        \
                         .popsection;
 
+/*
+ * Second alternative for the code of the immediately preceding PATCH, which
+ * takes precedence over the first alternative if both are applied. The old
+ * code is padded further if the second alternative is longer than both.
+ */
+#define PATCH_ALT(N, T) .set G, (908f - 907f) - (902b - 900b);          \
+                        .fill -(G > 0) * G / NOP_LEN, NOP_LEN, NOP_OPC; \
+906:                                                                    \
+                        .pushsection .patch.code, "a";                  \
+907:                    N;                                              \
+908:                    .popsection;                                    \
+                        .pushsection .patch.data, "a";                  \
+                        .balign 4;                                      \
+909:                    .long 900b - 909b;                              \
+                        .long 907b - 909b;                              \
+                        .byte 906b - 900b;                              \
+                        .byte 908b - 907b;                              \
+                        .word T;                                        \
+                        .popsection;
+
 #ifndef __ASSEMBLER__
 
 #include "types.hpp"
@@ -81,6 +81,14 @@ class Pd final : public Kobject
 
         void destroy()
         {
+            dma_cache.flush();
+            gst_cache.flush();
+            hst_cache.flush();
+            msr_cache.flush();
+            obj_cache.flush();
+            pio_cache.flush();
+            fpu_cache.flush();
+
             this->~Pd();
 
             operator delete (this, cache);
@@ -98,7 +106,7 @@ class Pd final : public Kobject
         Space_pio *create_pio (Status &, Space_obj *, unsigned long);
 
         static Pd *create_pd (Status &, Space_obj *, unsigned long, unsigned);
-        static Ec *create_ec (Status &, Space_obj *, unsigned long, Pd *, cpu_t, uintptr_t, uintptr_t, uintptr_t, uint8_t);
+        static Ec *create_ec (Status &, Space_obj *, unsigned long, Pd *, cpu_t, uintptr_t, uintptr_t, uintptr_t, uint8_t, uint8_t);
         static Sc *create_sc (Status &, Space_obj *, unsigned long, Ec *, cpu_t, uint16_t, uint8_t, uint16_t);
         static Pt *create_pt (Status &, Space_obj *, unsigned long, Ec *, uintptr_t);
         static Sm *create_sm (Status &, Space_obj *, unsigned long, uint64_t, unsigned = ~0U);
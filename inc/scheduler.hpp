@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "bits.hpp"
 #include "queue.hpp"
 #include "spinlock.hpp"
 
@@ -46,8 +47,21 @@ class Scheduler final
         class Ready final
         {
             private:
-                Queue<Sc>   queue[priorities];
-                unsigned    prio_top { 0 };
+                static constexpr auto bpw { static_cast<unsigned>(8 * sizeof (unsigned long)) };
+
+                static_assert (priorities % bpw == 0 && priorities / bpw <= bpw);
+
+                Queue<Sc>       queue[priorities];
+                unsigned long   prio_sum { 0 };                 // Summary bitmap: one bit per prio_map word
+                unsigned long   prio_map[priorities / bpw] {};  // Priority bitmap: one bit per non-empty queue
+
+                ALWAYS_INLINE
+                inline unsigned prio_top() const
+                {
+                    auto const w { static_cast<unsigned>(bit_scan_msb (prio_sum)) };
+
+                    return w * bpw + static_cast<unsigned>(bit_scan_msb (prio_map[w]));
+                }
 
             public:
                 void enqueue (Sc *, uint64_t);
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include "atomic.hpp"
 #include "initprio.hpp"
 #include "spinlock.hpp"
 
@@ -28,17 +29,74 @@ class Slab_cache final
 {
     private:
         struct Slab;
+        struct Magazine;
+
+        // Per-Core Magazines (cache-line aligned to avoid false sharing)
+        struct alignas (64) Local
+        {
+            Magazine *  loaded      { nullptr };    // Loaded Magazine
+            Magazine *  previous    { nullptr };    // Previously Loaded Magazine
+            uint64_t    allocs      { 0 };          // Allocation Requests on this Core
+            uint64_t    frees       { 0 };          // Free Requests on this Core
+        };
 
         uint16_t const  bsz;                    // Buffer size
         uint16_t const  bps;                    // Buffers per Slab
+        uint16_t const  keep;                   // Empty Slabs Retained
+        uint16_t        nempty  { 0 };          // Empty Slabs
+        bool const      mag;                    // Magazine Layer Enabled
         Slab *          curr    { nullptr };    // Current (Partial) Slab
         Slab *          head    { nullptr };    // Head of Slab List
+        Magazine *      full    { nullptr };    // Depot: Full Magazines
+        Magazine *      empty   { nullptr };    // Depot: Empty Magazines
+        Atomic<Local *> local   { nullptr };    // Per-Core Magazine Array
+        uint64_t        allocs  { 0 };          // Allocation Requests without Magazines
+        uint64_t        frees   { 0 };          // Free Requests without Magazines
+        Slab_cache *    prev    { nullptr };    // Prev Slab_cache in Registry
+        Slab_cache *    next    { nullptr };    // Next Slab_cache in Registry
         Spinlock        lock;                   // Allocator Spinlock
 
+        static Slab_cache magazines;
+
+        static inline constinit Slab_cache *    list { nullptr };   // Registry of Slab Caches
+        static inline constinit Spinlock        list_lock;          // Registry Spinlock
+
+        static inline constinit Atomic<Slab_cache *> locals { nullptr };    // Slab Cache for Per-Core Magazine Arrays
+        static inline constinit Spinlock        locals_lock;        // Per-Core Magazine Array Spinlock
+
+        static Slab_cache *arrays();
+
+        Local *magazine();
+
+        [[nodiscard]] void *alloc_buffer();
+        [[nodiscard]] void *alloc_locked (Local *);
+
+        void free_buffer (void *);
+
+        void unlink (Slab *);
+        void drain();
+        size_t trim();
+
     public:
+        struct Stats
+        {
+            unsigned    slabs   { 0 };          // Slabs
+            unsigned    partial { 0 };          // Partial Slabs
+            unsigned    full    { 0 };          // Full Slabs
+            unsigned    empty   { 0 };          // Empty Slabs
+            uint64_t    allocs  { 0 };          // Allocation Requests
+            uint64_t    frees   { 0 };          // Free Requests
+        };
+
         [[nodiscard]] void *alloc();
 
         void free (void *);
 
-        Slab_cache (size_t, size_t);
+        void flush();
+
+        Stats stats();
+
+        static size_t reclaim();
+
+        Slab_cache (size_t, size_t, unsigned = 1, bool = true);
 };
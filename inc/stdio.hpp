@@ -89,6 +89,7 @@ constexpr auto trace_mask { TRACE_CPU       |
                             TRACE_PERF      |
                             TRACE_KILL      |
 #ifdef DEBUG
+                            TRACE_MEMORY    |
                             TRACE_DESTROY   |
                             TRACE_ERROR     |
 #endif
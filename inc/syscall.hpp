@@ -75,6 +75,15 @@ struct Sys_create_ec final : private Sys_abi
     uintptr_t sp() const { return p3(); }
 
     uintptr_t evt() const { return p4(); }
+
+    /*
+     * EC features, which do not fit into the 4 flag bits of p0
+     *
+     * Bit 0: vCPU virtual timer interrupts are delivered by NOVA (aarch64 only)
+     * Bit 1: vCPU polls before blocking in WFI (aarch64 only, requires bit 0)
+     * Bit 3-2: FPU switching policy (0=lazy, 1=eager, 2=adaptive)
+     */
+    uint8_t ftr() const { return p5() & BIT_RANGE (7, 0); }
 };
 
 struct Sys_create_sc final : private Sys_abi
@@ -143,7 +152,13 @@ struct Sys_ctrl_ec final : private Sys_abi
 
     bool strong() const { return flags() & BIT (0); }
 
+    bool vint() const { return flags() & BIT (1); }
+
     unsigned long ec() const { return p0() >> 8; }
+
+    auto vid() const { return static_cast<uint32_t>(p1()); }
+
+    auto vpr() const { return static_cast<uint8_t>(p1() >> 32); }
 };
 
 struct Sys_ctrl_sc final : private Sys_abi
@@ -21,17 +21,38 @@
 #include "compiler.hpp"
 #include "types.hpp"
 
+/*
+ * Timeouts are kept in a per-CPU pairing heap ordered by deadline. Enqueue
+ * is O(1) and dequeue of any timeout is O(log n) amortized. Each timeout
+ * links to its first child and its right sibling; prev links to the left
+ * sibling or, for a first child, to the parent.
+ */
 class Timeout
 {
     private:
         uint64_t    time    { 0 };
         Timeout *   prev    { nullptr };
         Timeout *   next    { nullptr };
+        Timeout *   child   { nullptr };
 
-        static inline constinit Timeout *list CPULOCAL { nullptr };
+        static constexpr uint64_t none { ~0ULL };
+
+        static inline constinit Timeout *heap CPULOCAL { nullptr };
+        static inline constinit uint64_t dln  CPULOCAL { none };   // Programmed deadline
 
         virtual void trigger() = 0;
 
+        ALWAYS_INLINE
+        inline bool queued() const { return this == heap || prev; }
+
+        static Timeout *meld (Timeout *, Timeout *);
+        static Timeout *combine (Timeout *);
+
+        void remove();
+
+        static void program (uint64_t);
+        static void update();
+
     public:
         // Enforce a constructor for CPU-local timeouts
         Timeout() {}
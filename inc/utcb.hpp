@@ -52,6 +52,18 @@ class Utcb final
             return Buddy::alloc (0, Buddy::Fill::BITS0);
         }
 
+        /*
+         * Allocate UTCB on a specific node
+         *
+         * @param node  Preferred NUMA node
+         * @return      Pointer to the UTCB (allocation success) or nullptr (allocation failure)
+         */
+        [[nodiscard]] static void *operator new (size_t, Numa::node_t node) noexcept
+        {
+            static_assert (sizeof (Utcb) <= PAGE_SIZE (0));
+            return Buddy::alloc (0, Buddy::Fill::BITS0, node);
+        }
+
         /*
          * Deallocate UTCB
          *
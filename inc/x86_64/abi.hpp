@@ -32,6 +32,7 @@ class Sys_abi
         auto       &p2() const { return s.rdx; }
         auto const &p3() const { return s.rax; }
         auto const &p4() const { return s.r8;  }
+        auto const &p5() const { return s.r9;  }
 
         ALWAYS_INLINE uint8_t flags() const { return p0() >> 4 & BIT_RANGE (3, 0); }
 };
@@ -0,0 +1,45 @@
+/*
+ * Address Space Identifier (ASID)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "cpu.hpp"
+
+/*
+ * ASIDs are assigned per CPU on the first VMRUN on that CPU. When a CPU
+ * runs out of ASIDs, it starts a new generation, which invalidates all tags
+ * of older generations. A newly assigned ASID is flushed on its first VMRUN.
+ */
+class Asid final
+{
+    private:
+        static constexpr unsigned bits { 16 };
+
+        static uint64_t gen  CPULOCAL;      // Current Generation (per Core)
+        static uint16_t used CPULOCAL;      // ASIDs Assigned in the Current Generation (per Core)
+
+    public:
+        /*
+         * Check if a tag belongs to the current generation on this CPU
+         *
+         * @param t     Tag (generation, CPU and ASID) or 0 if unassigned
+         * @return      True if the ASID in the tag can be used, false otherwise
+         */
+        static bool valid (uint64_t t) { return static_cast<uint16_t>(t) && t >> bits == (gen << bits | Cpu::id); }
+
+        static uint16_t assign (uint64_t &);
+};
@@ -28,13 +28,20 @@
 class Counter final
 {
     private:
-        Atomic<unsigned> val { 0 };
+        // Only the owning CPU writes its counters, so inc and add need no atomic read-modify-write
+        Atomic<uint64_t> val { 0 };
 
     public:
         static Counter req[NUM_IPI] CPULOCAL;
         static Counter loc[NUM_LVT] CPULOCAL;
         static Counter schedule     CPULOCAL;
         static Counter helping      CPULOCAL;
+        static Counter xcall        CPULOCAL;
+        static Counter xcall_time   CPULOCAL;
+        static Counter buddy_hit    CPULOCAL;
+        static Counter buddy_lock   CPULOCAL;
+        static Counter buddy_remote CPULOCAL;
+        static Counter buddy_zero   CPULOCAL;
 
         ALWAYS_INLINE
         inline void inc()
@@ -43,7 +50,13 @@ class Counter final
         }
 
         ALWAYS_INLINE
-        inline unsigned get (cpu_t cpu) const
+        inline void add (uint64_t v)
+        {
+            val = val + v;
+        }
+
+        ALWAYS_INLINE
+        inline uint64_t get (cpu_t cpu) const
         {
             return *Kmem::loc_to_glob (cpu, &val);
         }
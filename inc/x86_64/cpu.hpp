@@ -29,6 +29,7 @@
 #include "extern.hpp"
 #include "kmem.hpp"
 #include "msr.hpp"
+#include "numa.hpp"
 #include "selectors.hpp"
 #include "spinlock.hpp"
 #include "types.hpp"
@@ -114,6 +115,7 @@ class Cpu final
             HWP_FAM                 =  2 * 32 + 18,     // HWP Fast Access Mode
             // EAX=0x7 ECX=0x0 (EBX)
             SMEP                    =  3 * 32 +  7,     // Supervisor Mode Execution Prevention
+            INVPCID                 =  3 * 32 + 10,     // INVPCID Instruction
             RDT_M                   =  3 * 32 + 12,     // RDT Monitoring (PQM)
             RDT_A                   =  3 * 32 + 15,     // RDT Allocation (PQE)
             RDSEED                  =  3 * 32 + 18,     // RDSEED Instruction
@@ -282,6 +284,8 @@ class Cpu final
         static inline constinit cpu_t           count  { 0 };
         static inline constinit Atomic<cpu_t>   online { 0 };
 
+        static inline constinit Numa::node_t    node[NUM_CPU] { 0 };    // NUMA Node (from SRAT)
+
         static void init();
         static void fini();
         static void halt();
@@ -298,6 +302,19 @@ class Cpu final
             features[std::to_underlying (f) / 32] &= ~BIT (std::to_underlying (f) % 32);
         }
 
+        /*
+         * Determine if all cores are online, which implies that CPU-local
+         * memory is mapped on every core
+         *
+         * @return  True if all cores are online, false otherwise
+         */
+        static bool all_online()
+        {
+            cpu_t const o { online };
+
+            return o && o == count;
+        }
+
         static void preemption_disable()    { asm volatile ("cli" : : : "memory"); }
         static void preemption_enable()     { asm volatile ("sti" : : : "memory"); }
         static void preemption_point()      { asm volatile ("sti; nop; cli" : : : "memory"); }
@@ -45,6 +45,7 @@ class Cr final
 
         DEFINE_CR (0)
         DEFINE_CR (2)
+        DEFINE_CR (3)
         DEFINE_CR (4)
 
         ALWAYS_INLINE
@@ -42,7 +42,7 @@ class Ec_arch final : private Ec
         Ec_arch (bool, Fpu *, Refptr<Space_obj> &, Refptr<Space_hst> &, Refptr<Space_pio> &, cpu_t, unsigned long, uintptr_t, uintptr_t, void *);
 
         // Constructor: GST EC (VMX)
-        Ec_arch (bool, Fpu *, Refptr<Space_obj> &, Refptr<Space_hst> &, Vmcs *, cpu_t, unsigned long, uintptr_t, uintptr_t, void *);
+        Ec_arch (bool, Fpu *, Refptr<Space_obj> &, Refptr<Space_hst> &, Vmcs *, Vmcs_cache *, cpu_t, unsigned long, uintptr_t, uintptr_t, void *, Exit_table *);
 
         // Constructor: GST EC (SVM)
         Ec_arch (bool, Fpu *, Refptr<Space_obj> &, Refptr<Space_hst> &, Vmcb *, cpu_t, unsigned long, uintptr_t);
@@ -59,6 +59,7 @@ class Ec_arch final : private Ec
         [[noreturn]] static void failed_vmx() asm ("vmx_failure");
         [[noreturn]] static void handle_svm() asm ("svm_handler");
 
+        bool handle_exc_xfd();
         bool handle_exc_gp (Exc_regs *);
         bool handle_exc_pf (Exc_regs *);
 
@@ -68,6 +69,8 @@ class Ec_arch final : private Ec
 
         [[noreturn]] void vmx_extint();
 
+        bool vmx_resolve (unsigned);
+
         ALWAYS_INLINE
         inline void redirect_to_iret()
         {
@@ -75,6 +78,20 @@ class Ec_arch final : private Ec
             exc_regs().rip = exc_regs().ip();
         }
 
+        /*
+         * Save live AMX tile state before guest XCR0 is loaded
+         *
+         * Guest XCR0 never enables tile state (see State_xsv::constrain_xcr). Loading it
+         * with XSETBV is expected to initialize TILECFG and TILEDATA, so that state must
+         * be saved first.
+         */
+        ALWAYS_INLINE
+        static inline void save_tiles()
+        {
+            if (EXPECT_FALSE (fpowner && fpowner->regs.tiles))
+                switch_fpu (nullptr);
+        }
+
         [[noreturn]] static void ret_user_hypercall (Ec *);
 
         [[noreturn]] static void ret_user_exception (Ec *) asm ("ret_user_iret");
@@ -117,9 +134,42 @@ class Ec_arch final : private Ec
                 return state->save_exc (mtd, exc_regs());
         }
 
+        /*
+         * Prepare the EC for execution on the current CPU
+         *
+         * @return      True if the host space has a page table for this CPU, false otherwise
+         */
+        ALWAYS_INLINE
+        inline bool prepare_cpu()
+        {
+            auto const hst { regs.get_hst() };
+
+            hst->init (Cpu::id);
+
+            return hst->get_ptab (Cpu::id);
+        }
+
+        /*
+         * Post virtual interrupt
+         *
+         * @return      BAD_FTR (virtual interrupts are injected by the VMM)
+         */
+        ALWAYS_INLINE
+        inline Status post_vint (unsigned, uint8_t) { return Status::BAD_FTR; }
+
+        /*
+         * Wake the vCPU if it is blocked in WFI (vCPUs never block in the kernel)
+         */
+        ALWAYS_INLINE
+        inline void wake_wfi() {}
+
         [[noreturn]] ALWAYS_INLINE
         inline void make_current()
         {
+            // Assign the FPU ahead of its first use if the FPU policy says so
+            if (current != this)
+                fpu_prefetch (current);
+
             Tss::run.rsp[0] = reinterpret_cast<uintptr_t>(&exc_regs() + 1);
             assert (!(Tss::run.rsp[0] & 0xf));
 
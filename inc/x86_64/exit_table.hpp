@@ -0,0 +1,126 @@
+/*
+ * VM Exit Table
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "buddy.hpp"
+#include "macros.hpp"
+#include "memory.hpp"
+#include "types.hpp"
+
+/*
+ * The exit table is a page shared between a vCPU and its VMM. The VMM
+ * programs CPUID results, MSR values and permitted XCR0 bits, so that NOVA
+ * can resolve matching VM exits without a round trip through the VMM.
+ *
+ * The VMM may update the table at any time. NOVA only ever uses its
+ * contents as values that become visible to the guest.
+ */
+class Exit_table final
+{
+    public:
+        enum Flag : uint32_t
+        {
+            VALID       = BIT (0),  // Entry is valid
+            SUBLEAF     = BIT (1),  // CPUID: Entry also matches ECX input
+            WRITE       = BIT (1),  // MSR: WRMSR may change the bits in msk
+        };
+
+        struct Cpuid
+        {
+            uint32_t    leaf;       // EAX input
+            uint32_t    subleaf;    // ECX input
+            uint32_t    flags;
+            uint32_t    reserved;
+            uint32_t    eax, ebx, ecx, edx;
+        };
+
+        struct Msr
+        {
+            uint32_t    idx;        // ECX input
+            uint32_t    flags;
+            uint64_t    val;        // Value for RDMSR, updated by WRMSR
+            uint64_t    msk;        // Bits that WRMSR may change
+            uint64_t    reserved;
+        };
+
+        static_assert (__is_standard_layout (Cpuid) && sizeof (Cpuid) == 32);
+        static_assert (__is_standard_layout (Msr)   && sizeof (Msr)   == 32);
+
+    private:
+        uint64_t        xcr0;               // 0x000: XCR0 bits that XSETBV may set
+        uint64_t        reserved[7];        // 0x008
+        Cpuid           cpuid[62];          // 0x040
+        Msr             msr[64];            // 0x800
+
+    public:
+        /*
+         * Find CPUID entry
+         *
+         * @param l     Leaf (EAX input)
+         * @param s     Subleaf (ECX input)
+         * @return      Pointer to the entry (or nullptr if none matches)
+         */
+        Cpuid const *find_cpuid (uint32_t l, uint32_t s) const
+        {
+            for (auto const &e : cpuid)
+                if (e.flags & VALID && e.leaf == l && (!(e.flags & SUBLEAF) || e.subleaf == s))
+                    return &e;
+
+            return nullptr;
+        }
+
+        /*
+         * Find MSR entry
+         *
+         * @param i     MSR index (ECX input)
+         * @return      Pointer to the entry (or nullptr if none matches)
+         */
+        Msr *find_msr (uint32_t i)
+        {
+            for (auto &e : msr)
+                if (e.flags & VALID && e.idx == i)
+                    return &e;
+
+            return nullptr;
+        }
+
+        /*
+         * Check if XSETBV may set XCR0 to the specified value
+         *
+         * @param v     XCR0 value
+         * @return      true if permitted, false otherwise
+         */
+        bool permit_xcr0 (uint64_t v) const { return !(v & ~xcr0); }
+
+        /*
+         * Allocate exit table on a specific node
+         *
+         * @param node  Preferred NUMA node
+         * @return      Pointer to the exit table (allocation success) or nullptr (allocation failure)
+         */
+        [[nodiscard]] static void *operator new (size_t, Numa::node_t node) noexcept
+        {
+            static_assert (sizeof (Exit_table) == PAGE_SIZE (0));
+            return Buddy::alloc (0, Buddy::Fill::BITS0, node);
+        }
+
+        static void operator delete (void *ptr)
+        {
+            Buddy::free (ptr);
+        }
+};
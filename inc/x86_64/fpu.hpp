@@ -131,8 +131,8 @@ class Fpu final
                 // The X87 bit is always required
                 v |= Component::X87;
 
-                // Constrain to bits that are manageable
-                return hst_xsv.xcr & v;
+                // Constrain to bits that are manageable, AMX tile state is host-only
+                return hst_xsv.xcr & ~tiles & v;
             }
 
             /*
@@ -151,6 +151,9 @@ class Fpu final
 
         static State_xsv hst_xsv CPULOCAL;
 
+        // Live IA32_XFD value
+        static uint64_t xfd CPULOCAL;
+
         // XSAVE area format: XSAVES/compact (true), XSAVE/standard (false)
         static inline constinit bool compact { true };
 
@@ -163,6 +166,12 @@ class Fpu final
         // XSAVE state components managed by NOVA
         static constexpr uint64_t managed { Component::AVX512 | Component::AVX | Component::SSE | Component::X87 };
 
+        // AMX tile state components, managed in extended XSAVE areas only
+        static constexpr uint64_t tiles { Component::XTILEDATA | Component::XTILECFG };
+
+        // Extended XSAVE context size, including AMX tile state (0 if unsupported)
+        static inline constinit size_t size_ext { 0 };
+
         /*
          * Load FPU state from memory into registers
          *
@@ -170,35 +179,84 @@ class Fpu final
          * Patched alternative uses XRSTOR and standard format (see Patch::init)
          *
          * @param this  XSAVE area
+         * @param m     State components (managed, or managed and tiles for extended areas)
          */
         ALWAYS_INLINE
-        inline void load() const
+        inline void load (uint64_t m) const
         {
-            asm volatile (EXPAND (PATCH (xrstors64 %0, xrstor64 %0, PATCH_XSAVES)) : : "m" (*this), "d" (static_cast<uint32_t>(managed >> 32)), "a" (static_cast<uint32_t>(managed)));
+            asm volatile (EXPAND (PATCH (xrstors64 %0, xrstor64 %0, PATCH_XSAVES)) : : "m" (*this), "d" (static_cast<uint32_t>(m >> 32)), "a" (static_cast<uint32_t>(m)));
         }
 
         /*
          * Save FPU state from registers into memory
          *
          * The default method uses XSAVES and compacted format (if supported)
-         * Patched alternative uses XSAVE and standard format (see Patch::init)
+         * Patched alternative uses XSAVEOPT and standard format (see Patch::init)
+         * Both skip components that are in their initial configuration or
+         * unmodified since the last XRSTOR(S) from this area. CPUs without
+         * XSAVEOPT are patched to use XSAVE instead.
          *
          * @param this  XSAVE area
+         * @param m     State components (managed, or managed and tiles for extended areas)
+         */
+        ALWAYS_INLINE
+        inline void save (uint64_t m)
+        {
+            asm volatile (EXPAND (PATCH (xsaves64 %0, xsaveopt64 %0, PATCH_XSAVES) PATCH_ALT (xsave64 %0, PATCH_XSAVEOPT)) : "+m" (*this) : "d" (static_cast<uint32_t>(m >> 32)), "a" (static_cast<uint32_t>(m)));
+        }
+
+        /*
+         * Arm or disarm XFD for AMX tile state
+         *
+         * AMX instructions ignore CR0.TS, so XFD must be armed whenever
+         * the current EC does not own live tile state.
+         *
+         * @param a     Trap tile use with #NM (true) or permit it (false)
          */
         ALWAYS_INLINE
-        inline void save()
+        static inline void arm_xfd (bool a)
         {
-            asm volatile (EXPAND (PATCH (xsaves64 %0, xsave64 %0, PATCH_XSAVES)) : "=m" (*this) : "d" (static_cast<uint32_t>(managed >> 32)), "a" (static_cast<uint32_t>(managed)));
+            auto const v { hst_xsv.xcr & tiles * a };
+
+            if (EXPECT_FALSE (xfd != v))
+                Msr::write (Msr::Reg64::IA32_XFD, xfd = v);
         }
 
         /*
-         * Disable FPU and clear FPU hazard
+         * Check if #NM was caused by XFD and acknowledge it
+         *
+         * @return      True if a tile access trapped, false otherwise
+         */
+        ALWAYS_INLINE
+        static inline bool xfd_fault()
+        {
+            if (!(hst_xsv.xcr & tiles) || !Msr::read (Msr::Reg64::IA32_XFD_ERR))
+                return false;
+
+            Msr::write (Msr::Reg64::IA32_XFD_ERR, 0);
+
+            return true;
+        }
+
+        /*
+         * Initialize AMX tile state (requires disarmed XFD)
+         */
+        ALWAYS_INLINE
+        static inline void release_tiles()
+        {
+            asm volatile ("tilerelease" : : : "memory");
+        }
+
+        /*
+         * Disable FPU, arm XFD and clear FPU hazard
          */
         ALWAYS_INLINE
         static inline void disable()
         {
             Cr::set_cr0 (Cr::get_cr0() | CR0_TS);
 
+            arm_xfd (true);
+
             Cpu::hazard &= ~Hazard::FPU;
         }
 
@@ -238,6 +296,10 @@ class Fpu final
                 cache.free (ptr);
         }
 
+        [[nodiscard]] static Fpu *create_ext (Numa::node_t);
+
+        static void destroy_ext (Fpu *);
+
         static void init();
         static void fini();
 };
@@ -64,6 +64,7 @@ class Interrupt final
         {
             RRQ,
             RKE,
+            RCL,
         };
 
         Sm *            sm      { nullptr };
@@ -94,5 +95,6 @@ class Interrupt final
         static inline void deactivate (unsigned gsi) { set_mask (gsi, false); }
 
         static void send_cpu (Request, cpu_t);
+        static void send_lgc (Request, uint32_t);
         static void send_exc (Request);
 };
@@ -159,6 +159,18 @@ class Lapic final
             set_icr ((x2apic ? static_cast<uint64_t>(Cpu::remote_topology (c)) << 32 : static_cast<uint64_t>(id[c]) << 56) | BIT (14) | std::to_underlying (d) << 8 | v);
         }
 
+        /*
+         * Send IPI to a set of CPUs within one x2APIC cluster
+         *
+         * @param v     Vector
+         * @param l     Logical destination (cluster ID and member bitmap)
+         * @param d     Delivery mode
+         */
+        static void send_lgc (unsigned v, uint32_t l, Delivery d = Delivery::DLV_FIXED)
+        {
+            set_icr (static_cast<uint64_t>(l) << 32 | BIT (14) | BIT (11) | std::to_underlying (d) << 8 | v);
+        }
+
         /*
          * Send IPI to all CPUs (excluding self)
          *
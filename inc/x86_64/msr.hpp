@@ -67,6 +67,8 @@ class Msr final
             IA32_MISC_ENABLE                = 0x1a0,
             TURBO_RATIO_LIMIT               = 0x1ad,
             IA32_PACKAGE_THERM_STATUS       = 0x1b1,
+            IA32_XFD                        = 0x1c4,        // XFD
+            IA32_XFD_ERR                    = 0x1c5,        // XFD
             IA32_DEBUGCTL                   = 0x1d9,
             POWER_CTL                       = 0x1fc,
             IA32_PAT                        = 0x277,        // PAT
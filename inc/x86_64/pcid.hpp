@@ -17,25 +17,49 @@
 
 #pragma once
 
-#include "atomic.hpp"
+#include "compiler.hpp"
 #include "macros.hpp"
 #include "types.hpp"
 
+/*
+ * PCIDs are assigned per CPU on first use. When a CPU runs out of PCIDs, it
+ * starts a new generation, which invalidates all tags of older generations.
+ * A newly assigned PCID is always flushed when it is loaded for the first
+ * time, so PCIDs of older generations can be reused without a global flush.
+ */
 class Pcid final
 {
     private:
-        uint16_t const val;
+        static constexpr unsigned bits { 12 };
 
-        static inline constinit Atomic<uint16_t> allocator { 0 };
+        static uint64_t gen  CPULOCAL;      // Current Generation (per Core)
+        static uint16_t used CPULOCAL;      // PCIDs Assigned in the Current Generation (per Core)
+
+    public:
+        /*
+         * Check if a tag belongs to the current generation on this CPU
+         *
+         * @param t     Tag (generation and PCID) or 0 if unassigned
+         * @return      True if the PCID in the tag can be used, false otherwise
+         */
+        static bool valid (uint64_t t) { return pcid (t) && t >> bits == gen; }
 
-        // FIXME: Handle overflow
-        static auto alloc()
+        /*
+         * Assign a new PCID on this CPU
+         *
+         * @return      Tag (generation and PCID)
+         */
+        static uint64_t alloc()
         {
-            return allocator++;
-        }
+            if (EXPECT_FALSE (used == BIT (bits) - 1)) {
+                gen  = gen + 1;
+                used = 0;
+            }
 
-    public:
-        Pcid() : val { alloc() } {}
+            used = static_cast<uint16_t>(used + 1);
+
+            return gen << bits | used;
+        }
 
-        operator auto() const { return val & BIT_RANGE (11, 0); }
+        static uintptr_t pcid (uint64_t t) { return t & BIT_RANGE (bits - 1, 0); }
 };
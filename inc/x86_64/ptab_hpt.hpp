@@ -122,6 +122,14 @@ class Hptp final : public Ptab<Hpt, uint64_t, uint64_t>
             asm volatile ("invlpg %0" : : "m" (*reinterpret_cast<uintptr_t *>(addr)) : "memory");
         }
 
+        ALWAYS_INLINE
+        static inline void invalidate (uintptr_t pcid, uintptr_t addr)
+        {
+            struct { uint64_t pcid, addr; } desc { pcid, addr };
+
+            asm volatile ("invpcid %0, %1" : : "m" (desc), "r" (0UL) : "memory");
+        }
+
         ALWAYS_INLINE
         static inline void master_map (IAddr v, OAddr p, unsigned o, Paging::Permissions pm, Memattr ma)
         {
@@ -32,8 +32,11 @@
 #include "space_pio.hpp"
 #include "svm.hpp"
 #include "types.hpp"
+#include "vmcs_cache.hpp"
 #include "vmx.hpp"
 
+class Exit_table;
+
 struct Sys_regs
 {
     uintptr_t   rax { 0 };
@@ -122,6 +125,16 @@ class alignas (16) Cpu_regs final
         Refptr<Space_pio>       pio     { nullptr };
         Refptr<Space_msr>       msr     { nullptr };
         Hazard                  hazard  { 0 };
+        bool                    tiles   { false };  // XSAVE area includes AMX tile state
+
+        union {
+            uint64_t            vpid    { 0 };      // VPID tag (VMX)
+            uint64_t            asid;               // ASID tag (SVM)
+        };
+
+        uint64_t                hcr3    { 0 };      // Host PCID tag in the VMCS (VMX)
+        Exit_table *            xtab    { nullptr };
+        Vmcs_cache *            vmcs_cache { nullptr };
 
         Cpu_regs (Refptr<Space_obj> &o, Refptr<Space_hst> &h, Refptr<Space_pio> &p) : vmcb { nullptr }, obj { std::move (o) }, hst { std::move (h) }, pio { std::move (p) } {}
         Cpu_regs (Refptr<Space_obj> &o, Refptr<Space_hst> &h, Vmcb *v) : vmcb { v }, obj { std::move (o) }, hst { std::move (h) }, hazard (Hazard::ILLEGAL) {}
@@ -140,7 +153,7 @@ class alignas (16) Cpu_regs final
         void vmx_set_cpu_sec (uint32_t) const;
         void vmx_set_cpu_ter (uint64_t) const;
 
-        void svm_set_bmp_exc() const { vmcb->intercept_exc = set_exc() | exc.intcpt_exc; }
+        void svm_set_bmp_exc() const { vmcb->update (vmcb->intercept_exc, set_exc() | exc.intcpt_exc, Vmcb::CLEAN_I); }
         void vmx_set_bmp_exc() const { Vmcs::write (Vmcs::Encoding::BITMAP_EXC, set_exc() | exc.intcpt_exc); }
 
         void vmx_set_msk_cr0() const { Vmcs::write (Vmcs::Encoding::CR0_MASK, msk_cr0<Vmcs>() | exc.intcpt_cr0); }
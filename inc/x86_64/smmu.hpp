@@ -28,6 +28,7 @@
 #include "lock_guard.hpp"
 #include "pci.hpp"
 #include "sdid.hpp"
+#include "stdio.hpp"
 #include "wait.hpp"
 
 class Space_dma;
@@ -70,6 +71,7 @@ class Smmu final : public List<Smmu>
         {
             ESRTPS      = 63,               // Enhanced Set Root Table Pointer Support
             ESIRTPS     = 62,               // Enhanced Set Interrupt Remap Table Pointer Support
+            PSI         = 39,               // Page Selective Invalidation
             PHMR        =  6,               // Protected Hi Memory Region
             PLMR        =  5,               // Protected Lo Memory Region
         };
@@ -166,6 +168,8 @@ class Smmu final : public List<Smmu>
             Inv_dsc_tlb() : Inv_dsc (Type::TLB, std::to_underlying (Gran::GLOBAL) << 4) {}
 
             Inv_dsc_tlb (uint16_t did) : Inv_dsc (Type::TLB, static_cast<uint64_t>(did) << 16 | std::to_underlying (Gran::DOMAIN) << 4) {}
+
+            Inv_dsc_tlb (uint16_t did, uint64_t addr, unsigned am) : Inv_dsc (Type::TLB, static_cast<uint64_t>(did) << 16 | std::to_underlying (Gran::PAGE) << 4, addr | am) {}
         };
 
         static_assert (__is_standard_layout (Inv_dsc_tlb) && sizeof (Inv_dsc_tlb) == sizeof (Inv_dsc));
@@ -257,7 +261,10 @@ class Smmu final : public List<Smmu>
         uint64_t            cap;
         uint64_t            ecap;
         unsigned            invq_idx            { 0 };
+        unsigned            invq_hd             { 0 };
         Inv_dsc *           invq                { nullptr };
+        Atomic<uint32_t>    invq_seq            { 0 };      // Last posted wait sequence
+        uint32_t volatile   invq_sts            { 0 };      // Last completed wait sequence (written by SMMU)
         Spinlock            inv_lock;
 
         static        Slab_cache    cache;
@@ -271,11 +278,13 @@ class Smmu final : public List<Smmu>
         static constexpr unsigned ord { 0 };
         static constexpr unsigned cnt { (PAGE_SIZE (0) << ord) / sizeof (Inv_dsc) };
         static constexpr unsigned timeout { 10 };
+        static constexpr unsigned psi_ord { 9 };        // Largest range (order) invalidated page-selectively
 
         bool feature (Cap  c) const { return cap  & BIT64 (std::to_underlying (c)); }
         bool feature (Ecap e) const { return ecap & BIT64 (std::to_underlying (e)); }
 
         auto nfr() const { return static_cast<unsigned>(cap >> 40 & BIT_RANGE (7, 0)) + 1; }
+        auto mam() const { return static_cast<unsigned>(cap >> 48 & BIT_RANGE (5, 0)); }
         auto fro() const { return static_cast<unsigned>(cap >> 20 & BIT_RANGE (13, 4)); }
         auto iro() const { return static_cast<unsigned>(ecap >> 4 & BIT_RANGE (13, 4)); }
 
@@ -308,23 +317,52 @@ class Smmu final : public List<Smmu>
         }
 
         /*
-         * QI: Invalidation
+         * QI: Queue descriptor without notifying the SMMU (with inv_lock held)
+         *
+         * @return      True if the descriptor was queued, false if the queue remained full
          */
-        void qi_post (Inv_dsc const &q)
+        [[nodiscard]] bool qi_post (Inv_dsc const &q)
         {
+            auto const nxt { (invq_idx + 1) % cnt };
+
+            // Wait for the SMMU to consume descriptors if the queue appears full
+            if (EXPECT_FALSE (nxt == invq_hd && !Wait::until (timeout, [&] { return nxt != (invq_hd = static_cast<unsigned>(read (Reg64::IQH) >> 4)); })))
+                return false;
+
             invq[invq_idx] = q;
-            invq_idx = (invq_idx + 1) % cnt;
+            invq_idx = nxt;
+
+            return true;
+        }
+
+        /*
+         * QI: Queue wait descriptor and notify the SMMU of all queued descriptors (with inv_lock held)
+         *
+         * @return      True if the wait descriptor was queued, false if the queue remained full
+         */
+        [[nodiscard]] bool qi_fence()
+        {
+            if (EXPECT_FALSE (!qi_post (Inv_dsc_iwt (Kmem::ptr_to_phys (const_cast<uint32_t *>(&invq_sts)), invq_seq + 1))))
+                return false;
+
+            invq_seq++;
+
             write (Reg64::IQT, invq_idx << 4);
+
+            return true;
         }
 
         /*
-         * QI: Wait for completion
+         * QI: Wait for completion of all descriptors posted so far
          */
         [[nodiscard]] bool qi_wait() const
         {
-            auto const v { read (Reg64::IQT) };
+            if (EXPECT_FALSE (!feature (Ecap::QI)))
+                return true;
 
-            return Wait::until (timeout, [&] { return read (Reg64::IQH) == v; });
+            auto const s { invq_seq.load() };
+
+            return Wait::until (timeout, [&] { return static_cast<int32_t>(invq_sts - s) >= 0; });
         }
 
         /*
@@ -363,6 +401,17 @@ class Smmu final : public List<Smmu>
             return ri_wait_tlb();
         }
 
+        /*
+         * RI: TLB Invalidation (Page-Selective within Domain)
+         */
+        [[nodiscard]] bool ri_inv_tlb (uint16_t did, uint64_t addr, unsigned am) const
+        {
+            write (Tlb64::IVA, addr | am);
+            write (Tlb64::IOTLB, BIT64 (63) | static_cast<uint64_t>(Inv_dsc_tlb::Gran::PAGE) << 60 | static_cast<uint64_t>(did) << 32);
+
+            return ri_wait_tlb();
+        }
+
         /*
          * RI: CTX Invalidation (Global)
          */
@@ -403,9 +452,7 @@ class Smmu final : public List<Smmu>
             if (EXPECT_FALSE (!feature (Ecap::QI)))
                 return ri_inv_tlb();
 
-            qi_post (Inv_dsc_tlb());
-
-            return qi_wait();
+            return qi_post (Inv_dsc_tlb()) && qi_fence() && qi_wait();
         }
 
         /*
@@ -418,9 +465,40 @@ class Smmu final : public List<Smmu>
             if (EXPECT_FALSE (!feature (Ecap::QI)))
                 return ri_inv_tlb (did);
 
-            qi_post (Inv_dsc_tlb (did));
+            return qi_post (Inv_dsc_tlb (did)) && qi_fence() && qi_wait();
+        }
+
+        /*
+         * TLB Invalidation (Domain-Selective), without waiting for completion
+         */
+        [[nodiscard]] bool invalidate_tlb_post (uint16_t did)
+        {
+            Lock_guard <Spinlock> guard { inv_lock };
+
+            if (EXPECT_FALSE (!feature (Ecap::QI)))
+                return ri_inv_tlb (did);
+
+            return qi_post (Inv_dsc_tlb (did)) && qi_fence();
+        }
+
+        /*
+         * TLB Invalidation (Page-Selective within Domain), without waiting for completion
+         *
+         * Falls back to domain-selective invalidation if the range is too large for the SMMU.
+         */
+        [[nodiscard]] bool invalidate_tlb_post (uint16_t did, uint64_t addr, unsigned o)
+        {
+            if (!feature (Cap::PSI) || o > mam() || o > psi_ord)
+                return invalidate_tlb_post (did);
+
+            addr &= ~OFFS_MASK (0) << o;
+
+            Lock_guard <Spinlock> guard { inv_lock };
+
+            if (EXPECT_FALSE (!feature (Ecap::QI)))
+                return ri_inv_tlb (did, addr, o);
 
-            return qi_wait();
+            return qi_post (Inv_dsc_tlb (did, addr, o)) && qi_fence();
         }
 
         /*
@@ -433,10 +511,7 @@ class Smmu final : public List<Smmu>
             if (EXPECT_FALSE (!feature (Ecap::QI)))
                 return ri_inv_ctx() && ri_inv_tlb();
 
-            qi_post (Inv_dsc_ctx());
-            qi_post (Inv_dsc_tlb());
-
-            return qi_wait();
+            return qi_post (Inv_dsc_ctx()) && qi_post (Inv_dsc_tlb()) && qi_fence() && qi_wait();
         }
 
         /*
@@ -449,10 +524,7 @@ class Smmu final : public List<Smmu>
             if (EXPECT_FALSE (!feature (Ecap::QI)))
                 return ri_inv_ctx (did) && ri_inv_tlb (did);
 
-            qi_post (Inv_dsc_ctx (did));
-            qi_post (Inv_dsc_tlb (did));
-
-            return qi_wait();
+            return qi_post (Inv_dsc_ctx (did)) && qi_post (Inv_dsc_tlb (did)) && qi_fence() && qi_wait();
         }
 
         /*
@@ -465,10 +537,7 @@ class Smmu final : public List<Smmu>
             if (EXPECT_FALSE (!feature (Ecap::QI)))
                 return ri_inv_ctx (sid, did) && ri_inv_tlb (did);
 
-            qi_post (Inv_dsc_ctx (sid, did));
-            qi_post (Inv_dsc_tlb (did));
-
-            return qi_wait();
+            return qi_post (Inv_dsc_ctx (sid, did)) && qi_post (Inv_dsc_tlb (did)) && qi_fence() && qi_wait();
         }
 
         /*
@@ -480,9 +549,7 @@ class Smmu final : public List<Smmu>
 
             Lock_guard <Spinlock> guard { inv_lock };
 
-            qi_post (Inv_dsc_iec());
-
-            return qi_wait();
+            return qi_post (Inv_dsc_iec()) && qi_fence() && qi_wait();
         }
 
         /*
@@ -494,9 +561,19 @@ class Smmu final : public List<Smmu>
 
             Lock_guard <Spinlock> guard { inv_lock };
 
-            qi_post (Inv_dsc_iec (idx));
+            return qi_post (Inv_dsc_iec (idx)) && qi_fence() && qi_wait();
+        }
+
+        /*
+         * IEC Invalidation (Index-Selective), without waiting for completion
+         */
+        [[nodiscard]] bool invalidate_iec_post (uint16_t idx)
+        {
+            assert (ir && feature (Ecap::QI));  // IR support implies QI support
+
+            Lock_guard <Spinlock> guard { inv_lock };
 
-            return qi_wait();
+            return qi_post (Inv_dsc_iec (idx)) && qi_fence();
         }
 
         /*
@@ -530,6 +607,16 @@ class Smmu final : public List<Smmu>
             command (Cmd::IRE);
         }
 
+        /*
+         * Wait for completion of all posted descriptors on all SMMUs
+         */
+        static void wait_all()
+        {
+            for (auto l { list }; l; l = l->next)
+                if (EXPECT_FALSE (!l->qi_wait()))
+                    panic ("SMMU: Invalidation timed out");
+        }
+
         bool clr_pmr()
         {
             write (Reg32::PMEN, 0);
@@ -553,11 +640,38 @@ class Smmu final : public List<Smmu>
                 l->init();
         }
 
+        /*
+         * TLB Invalidation (Domain-Selective) on all SMMUs
+         *
+         * The invalidation is posted to all SMMUs first, and then all of them are waited for together.
+         * An SMMU whose queue stays full is invalidated globally with a blocking invalidation instead.
+         * Stale translations would permit DMA to unmapped memory, so a failed invalidation is fatal.
+         */
         ALWAYS_INLINE
         static inline void invalidate_tlb_all (Sdid did)
         {
             for (auto l { list }; l; l = l->next)
-                l->invalidate_tlb (did);
+                if (EXPECT_FALSE (!l->invalidate_tlb_post (did) && !l->invalidate_tlb()))
+                    panic ("SMMU: TLB invalidation failed");
+
+            wait_all();
+        }
+
+        /*
+         * TLB Invalidation (Page-Selective within Domain) on all SMMUs
+         *
+         * @param did   Domain
+         * @param addr  Address of the range
+         * @param o     Order of the range (in pages)
+         */
+        ALWAYS_INLINE
+        static inline void invalidate_tlb_all (Sdid did, uint64_t addr, unsigned o)
+        {
+            for (auto l { list }; l; l = l->next)
+                if (EXPECT_FALSE (!l->invalidate_tlb_post (did, addr, o) && !l->invalidate_tlb()))
+                    panic ("SMMU: TLB invalidation failed");
+
+            wait_all();
         }
 
         ALWAYS_INLINE
@@ -589,7 +703,10 @@ class Smmu final : public List<Smmu>
             irt[idx].set (BIT (18) | src, static_cast<uint64_t>(dst) << (Lapic::x2apic ? 32 : 40) | vec << 16 | trg << 4 | BIT (0));
 
             for (auto l { list }; l; l = l->next)
-                l->invalidate_iec (idx);
+                if (EXPECT_FALSE (!l->invalidate_iec_post (idx) && !l->invalidate_iec()))
+                    panic ("SMMU: IEC invalidation failed");
+
+            wait_all();
         }
 
         static inline Smmu *lookup (uint64_t p)
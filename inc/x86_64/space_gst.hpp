@@ -39,6 +39,7 @@ class Space_gst final : public Space_mem<Space_gst>
         }
 
     public:
+        Cpuset  cpus;
         Cpuset  gtlb;
 
         static inline auto selectors() { return BIT64 (Ept::ibits - PAGE_BITS); }
@@ -87,7 +88,7 @@ class Space_gst final : public Space_mem<Space_gst>
 
         auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return eptp.update (v, p, o, pm, ma); }
 
-        void sync() { gtlb.set(); Tlb::shootdown (this); }
+        void sync (uint64_t, unsigned) { gtlb.set(); Tlb::shootdown (this, cpus); }
 
         void invalidate() { eptp.invalidate(); }
 
@@ -31,9 +31,55 @@
 class Space_hst final : public Space_mem<Space_hst>
 {
     private:
+        /*
+         * Per-CPU TLB state, kept out of line so that Space_hst fits into a slab buffer
+         */
+        class Tlb_state final
+        {
+            public:
+                // Pending TLB invalidation per CPU: none (0), full, or page address | page count
+                Atomic<uint64_t> inv[NUM_CPU] { 0 };
+
+                // PCID tag (generation and PCID) per CPU, only accessed by that CPU
+                uint64_t pcid[NUM_CPU] { 0 };
+
+                /*
+                 * Allocate TLB state
+                 *
+                 * @return      Pointer to the TLB state (allocation success) or nullptr (allocation failure)
+                 */
+                [[nodiscard]] ALWAYS_INLINE static void *operator new (size_t) noexcept
+                {
+                    static_assert (sizeof (Tlb_state) <= PAGE_SIZE (0));
+                    return Buddy::alloc (0);
+                }
+
+                /*
+                 * Deallocate TLB state
+                 *
+                 * @param ptr   Pointer to the TLB state (or nullptr)
+                 */
+                ALWAYS_INLINE
+                static void operator delete (void *ptr)
+                {
+                    Buddy::free (ptr);
+                }
+        };
+
+        Tlb_state *const tlbs;
+
         Space_hst();
 
-        Space_hst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::HST, p } {}
+        Space_hst (Refptr<Pd> &p, Tlb_state *t) : Space_mem { Kobject::Subtype::HST, p }, tlbs { t } {}
+
+        ~Space_hst() { delete tlbs; }
+
+        static constexpr unsigned tlb_ord  { 5 };       // Largest range (order) invalidated page by page
+        static constexpr uint64_t tlb_full { ~0ULL };   // Full invalidation pending
+
+        static uint64_t merge (uint64_t, uint64_t);
+
+        bool invalidate();
 
         void collect() override final
         {
@@ -41,12 +87,10 @@ class Space_hst final : public Space_mem<Space_hst>
         }
 
     public:
-        Pcid const  pcid;
         Hptp        hptp;
 
         Hptp        loc[NUM_CPU];
         Cpuset      cpus;
-        Cpuset      htlb;
 
         static Space_hst nova;
         static Space_hst *current CPULOCAL;
@@ -67,17 +111,24 @@ class Space_hst final : public Space_mem<Space_hst>
 
             else {
 
-                auto const hst { new (cache) Space_hst { ref_pd } };
+                auto const tlb { new Tlb_state };
+
+                if (EXPECT_TRUE (tlb)) {
+
+                    auto const hst { new (cache) Space_hst { ref_pd, tlb } };
 
-                // If we created hst, then reference must have been consumed
-                assert (!hst || !ref_pd);
+                    // If we created hst, then reference must have been consumed
+                    assert (!hst || !ref_pd);
 
-                if (EXPECT_TRUE (hst)) {
+                    if (EXPECT_TRUE (hst)) {
 
-                    if (EXPECT_TRUE (hst->hptp.root_init()))
-                        return hst;
+                        if (EXPECT_TRUE (hst->hptp.root_init()))
+                            return hst;
 
-                    operator delete (hst, cache);
+                        operator delete (hst, cache);
+                    }
+
+                    delete tlb;
                 }
 
                 s = Status::MEM_OBJ;
@@ -99,17 +150,25 @@ class Space_hst final : public Space_mem<Space_hst>
 
         auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return hptp.update (v, p, o, pm, ma); }
 
-        void sync() { htlb.set(); Tlb::shootdown (this); }
+        void sync (uint64_t, unsigned);
 
         ALWAYS_INLINE
         inline void make_current()
         {
-            uintptr_t p = pcid;
+            auto &tag { tlbs->pcid[Cpu::id] };
 
-            if (EXPECT_FALSE (htlb.tst (Cpu::id)))
-                htlb.clr (Cpu::id);
+            auto const fresh { !Pcid::valid (tag) };
 
-            else {
+            // A newly assigned PCID is flushed below, which covers pending invalidations
+            if (EXPECT_FALSE (fresh)) {
+                tag = Pcid::alloc();
+                tlbs->inv[Cpu::id] = 0;
+            }
+
+            uintptr_t p = Pcid::pcid (tag);
+
+            // Without pending invalidations or with page-selective ones, the PCID can be preserved
+            if (EXPECT_TRUE (!fresh && (!stale (Cpu::id) || invalidate()))) {
 
                 if (EXPECT_TRUE (current == this))
                     return;
@@ -122,7 +181,9 @@ class Space_hst final : public Space_mem<Space_hst>
             loc[Cpu::id].make_current (Cpu::feature (Cpu::Feature::PCID) ? p : 0);
         }
 
-        auto get_pcid() const { return pcid; }
+        bool stale (cpu_t cpu) const { return tlbs->inv[cpu]; }
+
+        auto tag (cpu_t cpu) const { return tlbs->pcid[cpu]; }
 
         void init (cpu_t);
 
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include "arch.hpp"
 #include "kmem.hpp"
 #include "utcb.hpp"
 
@@ -51,25 +52,29 @@ class Vmcb final
                 uint64_t    inj_control;            // 0xa8
                 uint64_t    npt_cr3;                // 0xb0
                 uint64_t    lbr;                    // 0xb8
+                uint32_t    clean;                  // 0xc0
             };
         };
 
         Utcb_segment        es, cs, ss, ds, fs, gs, gdtr, ldtr, idtr, tr;
-        char                reserved3[48];
+        char                reserved3[43];
+        uint8_t             cpl;
+        char                reserved4[4];
         uint64_t            efer;
-        char                reserved4[112];
+        char                reserved5[112];
         uint64_t            cr4, cr3, cr0, dr7, dr6, rflags, rip;
-        char                reserved5[88];
+        char                reserved6[88];
         uint64_t            rsp;
-        char                reserved6[24];
+        char                reserved7[24];
         uint64_t            rax, star, lstar, cstar, sfmask, kernel_gs_base;
         uint64_t            sysenter_cs, sysenter_esp, sysenter_eip, cr2, nrip;
-        char                reserved7[24];
+        char                reserved8[24];
         uint64_t            g_pat;
 
         static uint64_t     root        CPULOCAL;
-        static unsigned     asid_ctr    CPULOCAL;
+        static uint64_t     hsave       CPULOCAL;
         static uint32_t     svm_version CPULOCAL;
+        static uint32_t     svm_asids   CPULOCAL;
         static uint32_t     svm_feature CPULOCAL;
 
         static constexpr uintptr_t fix_cr0_set { 0 };
@@ -156,15 +161,58 @@ class Vmcb final
                                                 CPU_CLGI        |
                                                 CPU_SKINIT      };
 
-        Vmcb (uintptr_t, uintptr_t);
+        // VMCB state groups that VMRUN may take from its cache if marked clean
+        enum Clean
+        {
+            CLEAN_I         = BIT  (0),     // Intercepts, TSC offset
+            CLEAN_IOPM      = BIT  (1),     // I/O and MSR permission maps
+            CLEAN_ASID      = BIT  (2),     // ASID
+            CLEAN_TPR       = BIT  (3),     // Virtual interrupt control
+            CLEAN_NP        = BIT  (4),     // Nested paging, G_PAT
+            CLEAN_CRX       = BIT  (5),     // CR0, CR3, CR4, EFER
+            CLEAN_DRX       = BIT  (6),     // DR6, DR7
+            CLEAN_DT        = BIT  (7),     // GDTR, IDTR
+            CLEAN_SEG       = BIT  (8),     // CS, DS, ES, SS, CPL
+            CLEAN_CR2       = BIT  (9),     // CR2
+            CLEAN_LBR       = BIT (10),     // Last branch record
+        };
 
-        Vmcb()
+        static constexpr uint32_t clean_all { BIT_RANGE (10, 0) };
+
+        Vmcb() : int_control { BIT64 (24) }, efer { EFER_SVME }, g_pat { 0x7040600070406ull } {}
+
+        static bool has_npt()           { return svm_feature & BIT (0); }
+        static bool has_clean()         { return svm_feature & BIT (5); }
+        static bool has_flush_asid()    { return svm_feature & BIT (6); }
+        static bool has_urg()           { return true; }
+
+        /*
+         * Update a VMCB field and mark its state group as modified
+         *
+         * Unchanged values leave the group clean, so that VMRUN can
+         * keep using its cached copy.
+         *
+         * @param f     VMCB field
+         * @param v     New value
+         * @param c     Clean-bit group that contains the field
+         */
+        template<typename T, typename V>
+        void update (T &f, V const &v, uint32_t c)
         {
-            asm volatile ("vmsave" : : "a" (Kmem::ptr_to_phys (this)) : "memory");
+            if (f == static_cast<T>(v))
+                return;
+
+            f = static_cast<T>(v);
+            clean &= ~c;
         }
 
-        static bool has_npt() { return Vmcb::svm_feature & 1; }
-        static bool has_urg() { return true; }
+        /*
+         * Mark all state groups as unmodified after #VMEXIT
+         */
+        void mark_clean() { clean = has_clean() ? clean_all : 0; }
+
+        // TLB_CONTROL value that flushes the current ASID
+        static uint32_t tlb_flush_asid() { return has_flush_asid() ? 3 : 1; }
 
         static void init();
 
@@ -173,6 +221,17 @@ class Vmcb final
             return Buddy::alloc (0, Buddy::Fill::BITS0);
         }
 
+        /*
+         * Allocate VMCB on a specific node
+         *
+         * @param node  Preferred NUMA node
+         * @return      Pointer to the VMCB (allocation success) or nullptr (allocation failure)
+         */
+        [[nodiscard]] static void *operator new (size_t, Numa::node_t node) noexcept
+        {
+            return Buddy::alloc (0, Buddy::Fill::BITS0, node);
+        }
+
         static void operator delete (void *ptr)
         {
             Buddy::free (ptr);
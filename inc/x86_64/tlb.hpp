@@ -21,10 +21,24 @@
 
 #pragma once
 
+#include "atomic.hpp"
+#include "compiler.hpp"
+#include "types.hpp"
+
+class Cpuset;
 class Space;
 
 class Tlb final
 {
+    private:
+        static inline constinit Atomic<uint64_t> gen { 0 };     // Shootdown Generation
+        static uint64_t ack CPULOCAL;                           // Acknowledged Generation (per Core)
+
     public:
-        static void shootdown (Space *);
+        /*
+         * Acknowledge all shootdowns issued so far (from the RKE handler)
+         */
+        static void acknowledge() { ack = gen; }
+
+        static void shootdown (Space *, Cpuset const &);
 };
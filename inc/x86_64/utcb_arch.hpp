@@ -41,6 +41,8 @@ class Utcb_segment final
             limit = l;
             base  = b;
         }
+
+        bool operator== (Utcb_segment const &) const = default;
 };
 
 class Utcb_arch final
@@ -73,7 +75,7 @@ class Utcb_arch final
 
     public:
         void load_exc (Mtd_arch const, Exc_regs const &);
-        void load_vmx (Mtd_arch const, Cpu_regs const &);
+        void load_vmx (Mtd_arch const, Cpu_regs &);
         void load_svm (Mtd_arch const, Cpu_regs const &);
         bool save_exc (Mtd_arch const, Exc_regs &) const;
         bool save_vmx (Mtd_arch const, Cpu_regs &, Space_obj const *) const;
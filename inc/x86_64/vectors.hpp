@@ -24,7 +24,7 @@
 #include "config.hpp"
 
 #define NUM_FLT         1
-#define NUM_IPI         2
+#define NUM_IPI         3
 #define NUM_LVT         5
 #define NUM_GSI         (NUM_VEC - NUM_EXC - NUM_FLT - NUM_IPI - NUM_LVT)
 
@@ -0,0 +1,294 @@
+/*
+ * Virtual Machine Control Structure (VMCS) Field Cache
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "slab.hpp"
+#include "utcb_arch.hpp"
+#include "vmx.hpp"
+
+/*
+ * Software shadow of VMCS fields that the VMM transfers via the UTCB
+ *
+ * A group is valid if its shadow matches the current VMCS. Valid groups
+ * are read without VMREAD, and VMWRITE is skipped for unchanged groups.
+ * On VM exit, guest-state groups are invalidated unless the execution
+ * controls prevent the guest from changing them without that kind of exit.
+ * Control groups are only ever written by NOVA.
+ *
+ * The cache is allocated with the VMCS, so that host ECs do not carry it.
+ */
+class Vmcs_cache final
+{
+    public:
+        enum Group : unsigned
+        {
+            ES, CS, SS, DS, FS, GS, LDTR, TR, GDTR, IDTR,   // Order of the VMCS segment fields
+            PDPTE,
+            CR3,
+            DR7,
+            SYSENTER,
+            PAT,
+            EFER,
+            TPR,
+            PFE,
+            CPU_PRI,
+            CPU_SEC,
+        };
+
+    private:
+        static constexpr uint32_t guest { BIT_RANGE (EFER, ES) };
+        static constexpr uint32_t dtabs { BIT_RANGE (IDTR, LDTR) };
+
+        Utcb_segment    seg[IDTR + 1];
+        uint64_t        pdpte[4];
+        uint64_t        cr3, dr7, pat, efer;
+        uint64_t        sysenter_esp, sysenter_eip;
+        uint32_t        sysenter_cs;
+        uint32_t        tpr_threshold, pfe_mask, pfe_match;
+        uint32_t        cpu_pri { 0 }, cpu_sec { 0 };
+        uint32_t        valid { 0 };
+
+        static Slab_cache cache;
+
+        bool tst (Group g) const { return valid & BIT (g); }
+
+        void set (Group g) { valid |= BIT (g); }
+
+        // Segment fields are laid out with an encoding stride of 2
+        static auto enc (Vmcs::Encoding e, Group g) { return Vmcs::Encoding (std::to_underlying (e) + 2 * g); }
+
+    public:
+        Vmcs_cache() = default;
+
+        /*
+         * Invalidate the guest-state groups that the guest may have changed before a VM exit
+         *
+         * With CR3-load exiting and a CR3-target count of 0, CR3 only changes by an exiting
+         * MOV to CR3. With descriptor-table exiting, GDTR, IDTR, LDTR and TR only change by
+         * an exiting LGDT, LIDT, LLDT or LTR. Task switches always exit and change all of them.
+         *
+         * @param r     Basic exit reason
+         */
+        ALWAYS_INLINE
+        inline void invalidate (unsigned r)
+        {
+            auto m { guest };
+
+            if (r != Vmcs::VMX_TASK_SWITCH) {
+
+                if (r != Vmcs::VMX_CR && cpu_pri & Vmcs::CPU_CR3_LOAD)
+                    m &= ~BIT (CR3);
+
+                if (r != Vmcs::VMX_GDTR_IDTR && r != Vmcs::VMX_LDTR_TR && cpu_pri & Vmcs::CPU_SECONDARY && cpu_sec & Vmcs::CPU_DESC_TABLE)
+                    m &= ~dtabs;
+            }
+
+            valid &= ~m;
+        }
+
+        /*
+         * Read segment or descriptor table register
+         *
+         * @param g     Group (ES...IDTR)
+         * @return      Segment state in UTCB format
+         */
+        Utcb_segment const &get_seg (Group g)
+        {
+            if (!tst (g)) {
+                auto const s { g < GDTR };
+                seg[g].set_vmx (s ? Vmcs::read<uint16_t> (enc (Vmcs::Encoding::GUEST_SEL_ES, g)) : 0,
+                                    Vmcs::read<uint64_t> (enc (Vmcs::Encoding::GUEST_BASE_ES, g)),
+                                    Vmcs::read<uint32_t> (enc (Vmcs::Encoding::GUEST_LIMIT_ES, g)),
+                                s ? Vmcs::read<uint32_t> (enc (Vmcs::Encoding::GUEST_AR_ES, g)) : 0);
+                set (g);
+            }
+
+            return seg[g];
+        }
+
+        /*
+         * Write segment or descriptor table register
+         *
+         * @param g     Group (ES...IDTR)
+         * @param u     Segment state in UTCB format
+         */
+        void set_seg (Group g, Utcb_segment const &u)
+        {
+            auto const s { g < GDTR };
+            auto const n { Utcb_segment { s ? u.sel : uint16_t { 0 }, s ? u.ar : uint16_t { 0 }, u.limit, u.base } };
+
+            if (tst (g) && seg[g].sel == n.sel && seg[g].ar == n.ar && seg[g].limit == n.limit && seg[g].base == n.base)
+                return;
+
+            if (s) {
+                Vmcs::write (enc (Vmcs::Encoding::GUEST_SEL_ES, g), n.sel);
+                Vmcs::write (enc (Vmcs::Encoding::GUEST_AR_ES,  g), (n.ar << 4 & 0x1f000) | (n.ar & 0xff));
+            }
+
+            Vmcs::write (enc (Vmcs::Encoding::GUEST_BASE_ES,  g), n.base);
+            Vmcs::write (enc (Vmcs::Encoding::GUEST_LIMIT_ES, g), n.limit);
+
+            seg[g] = n;
+            set (g);
+        }
+
+        uint64_t const *get_pdpte()
+        {
+            if (!tst (PDPTE)) {
+                pdpte[0] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE0);
+                pdpte[1] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE1);
+                pdpte[2] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE2);
+                pdpte[3] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE3);
+                set (PDPTE);
+            }
+
+            return pdpte;
+        }
+
+        void set_pdpte (uint64_t const (&p)[4])
+        {
+            if (tst (PDPTE) && pdpte[0] == p[0] && pdpte[1] == p[1] && pdpte[2] == p[2] && pdpte[3] == p[3])
+                return;
+
+            Vmcs::write (Vmcs::Encoding::GUEST_PDPTE0, pdpte[0] = p[0]);
+            Vmcs::write (Vmcs::Encoding::GUEST_PDPTE1, pdpte[1] = p[1]);
+            Vmcs::write (Vmcs::Encoding::GUEST_PDPTE2, pdpte[2] = p[2]);
+            Vmcs::write (Vmcs::Encoding::GUEST_PDPTE3, pdpte[3] = p[3]);
+            set (PDPTE);
+        }
+
+        void get_sysenter (uint64_t &c, uint64_t &s, uint64_t &i)
+        {
+            if (!tst (SYSENTER)) {
+                sysenter_cs  = Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_SYSENTER_CS);
+                sysenter_esp = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_SYSENTER_ESP);
+                sysenter_eip = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_SYSENTER_EIP);
+                set (SYSENTER);
+            }
+
+            c = sysenter_cs;
+            s = sysenter_esp;
+            i = sysenter_eip;
+        }
+
+        void set_sysenter (uint64_t c, uint64_t s, uint64_t i)
+        {
+            if (tst (SYSENTER) && sysenter_cs == c && sysenter_esp == s && sysenter_eip == i)
+                return;
+
+            Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_CS,  sysenter_cs  = static_cast<uint32_t>(c));
+            Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_ESP, sysenter_esp = s);
+            Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_EIP, sysenter_eip = i);
+            set (SYSENTER);
+        }
+
+        void set_pfe (uint32_t m, uint32_t v)
+        {
+            if (tst (PFE) && pfe_mask == m && pfe_match == v)
+                return;
+
+            Vmcs::write (Vmcs::Encoding::PF_ERROR_MASK,  pfe_mask  = m);
+            Vmcs::write (Vmcs::Encoding::PF_ERROR_MATCH, pfe_match = v);
+            set (PFE);
+        }
+
+        void set_tpr (uint32_t v)
+        {
+            if (tst (TPR) && tpr_threshold == v)
+                return;
+
+            Vmcs::write (Vmcs::Encoding::TPR_THRESHOLD, tpr_threshold = v);
+            set (TPR);
+        }
+
+        uint32_t get_cpu_pri()
+        {
+            if (!tst (CPU_PRI)) {
+                cpu_pri = Vmcs::read<uint32_t> (Vmcs::Encoding::CPU_CONTROLS_PRI);
+                set (CPU_PRI);
+            }
+
+            return cpu_pri;
+        }
+
+        void set_cpu_pri (uint32_t v)
+        {
+            if (tst (CPU_PRI) && cpu_pri == v)
+                return;
+
+            Vmcs::write (Vmcs::Encoding::CPU_CONTROLS_PRI, cpu_pri = v);
+            set (CPU_PRI);
+        }
+
+        void set_cpu_sec (uint32_t v)
+        {
+            if (tst (CPU_SEC) && cpu_sec == v)
+                return;
+
+            Vmcs::write (Vmcs::Encoding::CPU_CONTROLS_SEC, cpu_sec = v);
+            set (CPU_SEC);
+        }
+
+        uint64_t get_cr3()  { return get (CR3,  cr3,  Vmcs::Encoding::GUEST_CR3);  }
+        uint64_t get_dr7()  { return get (DR7,  dr7,  Vmcs::Encoding::GUEST_DR7);  }
+        uint64_t get_pat()  { return get (PAT,  pat,  Vmcs::Encoding::GUEST_PAT);  }
+        uint64_t get_efer() { return get (EFER, efer, Vmcs::Encoding::GUEST_EFER); }
+
+        bool set_cr3  (uint64_t v) { return put (CR3,  cr3,  Vmcs::Encoding::GUEST_CR3,  v); }
+        bool set_dr7  (uint64_t v) { return put (DR7,  dr7,  Vmcs::Encoding::GUEST_DR7,  v); }
+        bool set_pat  (uint64_t v) { return put (PAT,  pat,  Vmcs::Encoding::GUEST_PAT,  v); }
+        bool set_efer (uint64_t v) { return put (EFER, efer, Vmcs::Encoding::GUEST_EFER, v); }
+
+    private:
+        uint64_t get (Group g, uint64_t &f, Vmcs::Encoding e)
+        {
+            if (!tst (g)) {
+                f = Vmcs::read<uint64_t> (e);
+                set (g);
+            }
+
+            return f;
+        }
+
+        /*
+         * Write a single-field group
+         *
+         * @return      true if the VMCS was written, false if the field was unchanged
+         */
+        bool put (Group g, uint64_t &f, Vmcs::Encoding e, uint64_t v)
+        {
+            if (tst (g) && f == v)
+                return false;
+
+            Vmcs::write (e, f = v);
+            set (g);
+
+            return true;
+        }
+
+    public:
+        [[nodiscard]] static void *operator new (size_t) noexcept
+        {
+            return cache.alloc();
+        }
+
+        static void operator delete (void *ptr)
+        {
+            cache.free (ptr);
+        }
+};
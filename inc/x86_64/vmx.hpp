@@ -536,7 +536,7 @@ class Vmcs final
             VMX_XSETBV              = 55,
         };
 
-        void init (uintptr_t, uintptr_t, uintptr_t, uint64_t, uint16_t);
+        void init (uintptr_t, uintptr_t, uintptr_t, uint64_t);
 
         ALWAYS_INLINE
         inline void clear()
@@ -601,6 +601,17 @@ class Vmcs final
             return Buddy::alloc (0, Buddy::Fill::BITS0);
         }
 
+        /*
+         * Allocate VMCS on a specific node
+         *
+         * @param node  Preferred NUMA node
+         * @return      Pointer to the VMCS (allocation success) or nullptr (allocation failure)
+         */
+        [[nodiscard]] static void *operator new (size_t, Numa::node_t node) noexcept
+        {
+            return Buddy::alloc (0, Buddy::Fill::BITS0, node);
+        }
+
         static void operator delete (void *ptr)
         {
             // FIXME: VMCLEAR if VMCS was active
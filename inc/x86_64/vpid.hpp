@@ -20,8 +20,7 @@
 
 #pragma once
 
-#include "atomic.hpp"
-#include "kmem.hpp"
+#include "cpu.hpp"
 
 class Invvpid final
 {
@@ -41,17 +40,29 @@ class Invvpid final
         Invvpid (uint16_t v, uint64_t a) : vpid { v }, addr { a } {}
 };
 
+/*
+ * VPIDs are assigned per CPU on the first VM entry on that CPU. When a CPU
+ * runs out of VPIDs, it starts a new generation, which invalidates all tags
+ * of older generations. A newly assigned VPID is invalidated before use.
+ */
 class Vpid final
 {
     private:
-        static Atomic<uint16_t> allocator CPULOCAL;
+        static constexpr unsigned bits { 16 };
+
+        static uint64_t gen  CPULOCAL;      // Current Generation (per Core)
+        static uint16_t used CPULOCAL;      // VPIDs Assigned in the Current Generation (per Core)
 
     public:
-        // FIXME: Handle overflow
-        static auto alloc (cpu_t cpu)
-        {
-            return ++*Kmem::loc_to_glob (cpu, &allocator);
-        }
+        /*
+         * Check if a tag belongs to the current generation on this CPU
+         *
+         * @param t     Tag (generation, CPU and VPID) or 0 if unassigned
+         * @return      True if the VPID in the tag can be used, false otherwise
+         */
+        static bool valid (uint64_t t) { return static_cast<uint16_t>(t) && t >> bits == (gen << bits | Cpu::id); }
+
+        static uint16_t assign (uint64_t &);
 
         static void invalidate (Invvpid::Type t, uint16_t vpid, uint64_t addr = 0)
         {
@@ -17,6 +17,54 @@
 
 #include "acpi_table_iort.hpp"
 #include "compiler.hpp"
+#include "intid.hpp"
+#include "smmu.hpp"
+#include "stdio.hpp"
+
+/*
+ * Convert a wired interrupt into an SPI with the trigger encoding of the board descriptions
+ *
+ * @param gsiv  Global System Interrupt Vector
+ * @param edge  Edge-triggered (true) or level-triggered (false)
+ * @return      SPI description (not present if the interrupt is not an SPI)
+ */
+static Smmu::Desc::Irq spi (uint32_t gsiv, bool edge)
+{
+    if (gsiv < Intid::from_spi (0) || gsiv >= Intid::from_spi (Intid::NUM_SPI))
+        return { 0, 0 };
+
+    return { Intid::to_spi (gsiv), edge ? 0x1U : 0x4U };
+}
+
+void Acpi_table_iort::Node_smmu_v2::parse() const
+{
+    Smmu::Desc d { .mmio = base, .arch = Smmu::Arch::SMMUv2 };
+
+    auto const g { reinterpret_cast<Irq const *>(reinterpret_cast<uintptr_t>(this) + glb_ofs) };
+    auto const c { reinterpret_cast<Irq const *>(reinterpret_cast<uintptr_t>(this) + ctx_ofs) };
+
+    // NSgIrpt signals global faults, NSgCfgIrpt is not used
+    d.glb[0] = spi (g->gsiv, g->flags & BIT (0));
+
+    for (unsigned i { 0 }; i < min (uint32_t { ctx_cnt }, static_cast<uint32_t>(sizeof (d.ctx) / sizeof (*d.ctx))); i++)
+        d.ctx[i] = spi (c[i].gsiv, c[i].flags & BIT (0));
+
+    trace (TRACE_FIRM | TRACE_PARSE, "SMMU: %#010lx v2 Model %u CTX Interrupts %u", uint64_t { base }, uint32_t { model }, uint32_t { ctx_cnt });
+
+    if (EXPECT_FALSE (!new Smmu { d }))
+        panic ("SMMU allocation failed");
+}
+
+void Acpi_table_iort::Node_smmu_v3::parse() const
+{
+    // Wired SMMUv3 interrupts are edge-triggered
+    Smmu::Desc d { .mmio = base, .arch = Smmu::Arch::SMMUv3, .glb { spi (gsiv_evt, true), spi (gsiv_err, true) } };
+
+    trace (TRACE_FIRM | TRACE_PARSE, "SMMU: %#010lx v3 Model %u EVT:%u ERR:%u", uint64_t { base }, uint32_t { model }, uint32_t { gsiv_evt }, uint32_t { gsiv_err });
+
+    if (EXPECT_FALSE (!new Smmu { d }))
+        panic ("SMMU allocation failed");
+}
 
 void Acpi_table_iort::parse() const
 {
@@ -24,6 +72,12 @@ void Acpi_table_iort::parse() const
 
         auto const n { reinterpret_cast<Node const *>(ptr) };
 
+        switch (n->type()) {
+            case Node::Type::SMMUv1v2: static_cast<Node_smmu_v2 const *>(n)->parse(); break;
+            case Node::Type::SMMUv3:   static_cast<Node_smmu_v3 const *>(n)->parse(); break;
+            default: break;
+        }
+
         ptr += n->length;
     }
 }
@@ -55,12 +55,16 @@ void Acpi_table_madt::Controller_gicc::parse() const
         Gicc::phys = phys_gicc;
     if (phys_gich)
         Gich::phys = phys_gich;
+    if (gsiv_vgic)
+        Gich::ppi_mnt = Intid::to_ppi (gsiv_vgic);
 
     // MPIDR format: Aff3[39:32] Aff2[23:16] Aff1[15:8] Aff0[7:0]
     auto const mpidr { val_mpidr };
 
-    if (Psci::states && Psci::boot_cpu (Cpu::count, mpidr))
-        Cpu::allocate (Cpu::count++, mpidr, phys_gicr);
+    if (Psci::states && Psci::boot_cpu (Cpu::count, mpidr)) {
+        Cpu::allocate (Cpu::count, mpidr, phys_gicr);
+        *Kmem::loc_to_glob (Cpu::count++, &Cpu::uid) = uid;
+    }
 }
 
 void Acpi_table_madt::Controller_gits::parse() const {}
@@ -16,8 +16,22 @@
  */
 
 #include "acpi_table_srat.hpp"
+#include "buddy.hpp"
+#include "cpu.hpp"
+#include "numa.hpp"
 #include "stdio.hpp"
 
+void Acpi_table_srat::Affinity_gicc::parse() const
+{
+    // Skip disabled entries
+    if (EXPECT_FALSE (!(flags & BIT (0))))
+        return;
+
+    for (cpu_t c { 0 }; c < Cpu::count; c++)
+        if (*Kmem::loc_to_glob (c, &Cpu::uid) == uid)
+            *Kmem::loc_to_glob (c, &Numa::node) = Numa::lookup (pxd);
+}
+
 void Acpi_table_srat::Affinity_memory::parse() const
 {
     // Skip disabled entries
@@ -25,6 +39,8 @@ void Acpi_table_srat::Affinity_memory::parse() const
         return;
 
     trace (TRACE_FIRM, "SRAT: %#018lx-%018lx Dom %u", uint64_t { base }, base + size, uint32_t { pxd });
+
+    Numa::add_memory (base, size, pxd);
 }
 
 void Acpi_table_srat::parse() const
@@ -35,9 +51,13 @@ void Acpi_table_srat::parse() const
 
         switch (a->type()) {
             case Affinity::Type::MEMORY: static_cast<Affinity_memory const *>(a)->parse(); break;
+            case Affinity::Type::GICC:   static_cast<Affinity_gicc   const *>(a)->parse(); break;
             default: break;
         }
 
         ptr += a->length;
     }
+
+    // Partition the memory pool into per-node zones
+    Buddy::rezone();
 }
@@ -21,3 +21,11 @@ Counter Counter::req[Intid::NUM_SGI];
 Counter Counter::loc[Intid::NUM_PPI];
 Counter Counter::schedule;
 Counter Counter::helping;
+Counter Counter::xcall;
+Counter Counter::xcall_time;
+Counter Counter::buddy_hit;
+Counter Counter::buddy_lock;
+Counter Counter::buddy_remote;
+Counter Counter::buddy_zero;
+Counter Counter::hpoll_hit;
+Counter Counter::hpoll_miss;
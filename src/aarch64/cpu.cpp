@@ -31,6 +31,7 @@
 bool Cpu::bsp;
 cpu_t Cpu::id;
 unsigned Cpu::hazard;
+uint32_t Cpu::uid;
 uint64_t Cpu::res0_hcr, Cpu::res0_hcrx;
 uint64_t Cpu::ptab, Cpu::midr, Cpu::mpidr, Cpu::gicr, Cpu::cptr, Cpu::mdcr;
 uint64_t Cpu::feat_cpu64[3], Cpu::feat_dbg64[2], Cpu::feat_isa64[4], Cpu::feat_mem64[5], Cpu::feat_sme64[1], Cpu::feat_sve64[1];
@@ -284,8 +285,11 @@ void Cpu::fini()
 {
     auto const s { Acpi::get_transition() };
 
-    if (s.state() > 1)
+    // Write back state that would not survive the transition
+    if (s.state() > 1) {
         Fpu::fini();
+        Vmcb::sync();
+    }
 
     Acpi::fini (s);
 }
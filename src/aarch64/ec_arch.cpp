@@ -16,17 +16,21 @@
  */
 
 #include "assert.hpp"
+#include "barrier.hpp"
+#include "counter.hpp"
 #include "cpu.hpp"
 #include "ec_arch.hpp"
 #include "entry.hpp"
 #include "event.hpp"
 #include "extern.hpp"
 #include "fpu.hpp"
+#include "gich.hpp"
 #include "pd.hpp"
 #include "rcu.hpp"
 #include "space_gst.hpp"
 #include "space_hst.hpp"
 #include "stdio.hpp"
+#include "timer.hpp"
 #include "vmcb.hpp"
 
 // Constructor: Kernel Thread
@@ -59,13 +63,28 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
 
     trace (TRACE_CREATE, "EC:%p created (OBJ:%p HST:%p CPU:%u VMCB:%p %c)", static_cast<void *>(this), static_cast<void *>(obj), static_cast<void *>(hst), c, static_cast<void *>(v), subtype == Kobject::Subtype::EC_VCPU_REAL ? 'R' : 'O');
 
+    // The virtual timer deadline wakes this vCPU from WFI
+    v->timeout.set_ec (this);
+
     exc_regs().sp() = sp;
     exc_regs().set_ep (Event::gst_arch + Event::Selector::STARTUP);
 }
 
 // Factory: GST EC
-Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t /*hva*/)
+Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, Fpu_mode fpm, bool xtb, bool vtm, bool hpl, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t /*hva*/)
 {
+    // Exit tables are not supported
+    if (EXPECT_FALSE (xtb)) {
+        s = Status::BAD_FTR;
+        return nullptr;
+    }
+
+    // Halt polling only applies to WFI handled in the kernel
+    if (EXPECT_FALSE (hpl && !vtm)) {
+        s = Status::BAD_PAR;
+        return nullptr;
+    }
+
     // Acquire references
     Refptr<Space_obj> ref_obj { pd->get_obj() };
     Refptr<Space_hst> ref_hst { pd->get_hst() };
@@ -77,11 +96,14 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     }
 
     auto const f { fpu ? new (pd->fpu_cache) Fpu : nullptr };
-    auto const v { new Vmcb };
+    auto const v { new (Numa::remote (cpu)) Vmcb };
     Ec *ec;
 
     if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
         assert (!ref_obj && !ref_hst);
+        ec->fpm = fpm;
+        v->vtm = vtm;
+        v->hpl = hpl;
         return ec;
     }
 
@@ -96,7 +118,133 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
 void Ec::adjust_offset_ticks (uint64_t t)
 {
     if (subtype == Kobject::Subtype::EC_VCPU_OFFS)
-        regs.vmcb->tmr.cntvoff += t;
+        regs.vmcb->adjust_cntvoff (t);
+}
+
+/*
+ * Post virtual interrupt for injection on the next guest entry
+ *
+ * @param id    Virtual INTID
+ * @param prio  Virtual priority
+ * @return      SUCCESS, BAD_CAP (EC is not a vCPU) or BAD_PAR (invalid INTID)
+ */
+Status Ec_arch::post_vint (unsigned id, uint8_t prio)
+{
+    if (EXPECT_FALSE (!is_vcpu()))
+        return Status::BAD_CAP;
+
+    if (EXPECT_FALSE (id >= Vmcb::num_vint))
+        return Status::BAD_PAR;
+
+    if (regs.vmcb->post (id, prio)) {
+
+        // Kick the vCPU out of guest mode only if it is running on a remote core
+        if (Cpu::id != cpu && Ec::remote_current (cpu) == this)
+            Interrupt::send_cpu (Interrupt::Request::RKE, cpu);
+
+        wake_wfi();
+    }
+
+    return Status::SUCCESS;
+}
+
+/*
+ * Block the current vCPU in WFI until an interrupt is pending
+ *
+ * The vCPU wakes when its virtual timer expires, when a virtual interrupt
+ * is posted to it or when it is recalled.
+ *
+ * @param self  Current vCPU
+ */
+void Ec_arch::handle_wfi (Ec *const self)
+{
+    auto const v { self->regs.vmcb };
+
+    // Complete the WFI instruction
+    self->exc_regs().el2.elr += self->exc_regs().el2.esr & BIT (25) ? 4 : 2;
+
+    uint64_t t;
+
+    if (!v->wfi_block (t) || self->regs.hazard & Hazard::RECALL)
+        return;
+
+    auto const now { Timer::time() };
+
+    // Poll for a wakeup before paying for blocking and unblocking
+    if (v->hpl && v->poll) {
+
+        for (auto c { now }; c - now < v->poll; c = Timer::time(), pause()) {
+
+            if (v->pending() || Gich::pending() || self->regs.hazard & Hazard::RECALL || (t && c >= t)) {
+                Counter::hpoll_hit.inc();
+                return;
+            }
+
+            // Polling runs with interrupts disabled, so resume the vCPU to take a pending host interrupt on guest entry
+            if (Cpu::irq_pending()) {
+                Counter::hpoll_miss.inc();
+                return;
+            }
+        }
+
+        Counter::hpoll_miss.inc();
+    }
+
+    v->halt = now;
+
+    v->save_tmr();
+
+    // The EC can no longer be activated
+    self->block();
+
+    // Publish the blocked state before checking for wakeup conditions again
+    v->wfi.store (1, __ATOMIC_RELEASE);
+    Barrier::fmb (Barrier::Domain::ISH);
+
+    // Recheck conditions that were signaled before the wfi flag became visible
+    if (EXPECT_FALSE (v->pending() || self->regs.hazard & Hazard::RECALL) && v->wfi.test_and_clr (1)) {
+        self->unblock (ret_user_vmexit, true);
+        return;
+    }
+
+    // At this point remote cores can unblock the EC
+
+    if (self->block_sc()) {
+
+        // An armed virtual timer deadline must wake this vCPU
+        if (t) {
+            assert (v->timeout.wakes (static_cast<Ec_arch *>(self)));
+            v->timeout.enqueue (t);
+        }
+
+        Scheduler::schedule (true);
+    }
+}
+
+/*
+ * Wake the vCPU if it is blocked in WFI
+ */
+void Ec_arch::wake_wfi()
+{
+    if (!is_vcpu() || !regs.vmcb->wfi.test_and_clr (1))
+        return;
+
+    // The EC can now be activated again
+    unblock (ret_user_wfi, Cpu::id == cpu);
+
+    unblock_sc();
+}
+
+void Ec_arch::ret_user_wfi (Ec *const self)
+{
+    auto const v { self->regs.vmcb };
+
+    v->timeout.dequeue();
+
+    if (v->hpl)
+        v->adapt_poll (Timer::time() - v->halt);
+
+    ret_user_vmexit (self);
 }
 
 void Ec::handle_hazard (unsigned h, cont_t func)
@@ -149,7 +297,7 @@ void Ec_arch::ret_user_hypercall (Ec *const self)
 
     trace (TRACE_CONT, "EC:%p %s to M:%#x IP:%#lx SP:%#lx", static_cast<void *>(self), __func__, self->exc_regs().mode(), self->exc_regs().ip(), self->exc_regs().sp());
 
-    if (Vmcb::current)
+    if (Vmcb::gst_active())
         Vmcb::load_hst();
 
     self->regs.get_hst()->make_current();
@@ -167,7 +315,7 @@ void Ec_arch::ret_user_exception (Ec *const self)
 
     trace (TRACE_CONT, "EC:%p %s to M:%#x IP:%#lx SP:%#lx", static_cast<void *>(self), __func__, self->exc_regs().mode(), self->exc_regs().ip(), self->exc_regs().sp());
 
-    if (Vmcb::current)
+    if (Vmcb::gst_active())
         Vmcb::load_hst();
 
     self->regs.get_hst()->make_current();
@@ -185,12 +333,7 @@ void Ec_arch::ret_user_vmexit (Ec *const self)
 
     trace (TRACE_CONT, "EC:%p %s to M:%#x IP:%#lx", static_cast<void *>(self), __func__, self->exc_regs().mode(), self->exc_regs().ip());
 
-    auto const v { self->regs.vmcb };
-
-    if (Vmcb::current != v)
-        v->load_gst();      // Restore full register state
-    else
-        v->load_tmr();      // Restore only vTMR PPI state
+    self->regs.vmcb->make_current();
 
     self->regs.get_gst()->make_current();
 
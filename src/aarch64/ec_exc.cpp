@@ -39,6 +39,12 @@ void Ec::fpu_save()
     regs.hazard.clr (Hazard::FPU);
 }
 
+Ec::~Ec()
+{
+    // A later FPU switch on that CPU would save into the FPU state of this EC
+    assert (*Kmem::loc_to_glob (cpu, &fpowner) != this);
+}
+
 void Ec_arch::handle_exc_kern (Exc_regs *r)
 {
     auto const iss { r->el2.esr & BIT_RANGE (24, 0) };
@@ -66,10 +72,16 @@ void Ec_arch::handle_exc_user (Exc_regs *r)
     else if (r->ep() == 0x7)
         resolved = switch_fpu (self);
 
+    // WFI from a vCPU whose virtual timer interrupts are delivered by NOVA
+    else if (r->ep() == 0x1 && !(esr & BIT_RANGE (1, 0)) && self->is_vcpu() && self->regs.vmcb->vtm) {
+        handle_wfi (self);
+        resolved = true;
+    }
+
     trace (TRACE_EXCEPTION, "EC:%p %s %#lx at M:%#x IP:%#lx", static_cast<void *>(self), self->is_vcpu() ? "VMX" : "EXC", r->ep(), r->mode(), r->el2.elr);
 
     if (self->is_vcpu()) {
-        self->regs.vmcb->save_gst();
+        self->regs.vmcb->save_tmr();
         resolved ? ret_user_vmexit (self) : send_msg<ret_user_vmexit> (self);
     } else
         resolved ? ret_user_exception (self) : send_msg<ret_user_exception> (self);
@@ -89,9 +101,9 @@ void Ec_arch::handle_irq_user()
     if (!self->is_vcpu())
         ret_user_exception (self);
 
-    self->regs.vmcb->save_gst();
+    self->regs.vmcb->save_tmr();
 
-    if (evt == Event::Selector::NONE)
+    if (evt == Event::Selector::NONE || (evt == Event::Selector::VTIMER && self->regs.vmcb->inject_tmr()))
         ret_user_vmexit (self);
 
     assert (self->regs.vmcb->tmr.cntv_act);
@@ -17,8 +17,10 @@
 
 #include "acpi.hpp"
 #include "gich.hpp"
+#include "interrupt.hpp"
 #include "space_hst.hpp"
 #include "stdio.hpp"
+#include "util.hpp"
 
 unsigned Gich::num_apr  { 0 };
 unsigned Gich::num_lr   { 0 };
@@ -28,6 +30,9 @@ void Gich::init()
     if (!Acpi::resume && Cpu::bsp && Gicc::mode == Gicc::Mode::MMIO)
         mmap_mmio();
 
+    // Configure maintenance interrupt
+    Interrupt::conf_ppi (ppi_mnt, false, true);
+
     switch (Gicc::mode) {
         case Gicc::Mode::MMIO: return init_mmio();
         case Gicc::Mode::REGS: return init_regs();
@@ -68,3 +73,136 @@ void Gich::init_regs()
 
     trace (TRACE_INTR, "GICH: REGS APR:%u LR:%u", num_apr, num_lr);
 }
+
+uint64_t Gich::get_lr (unsigned n)
+{
+    if (Gicc::mode == Gicc::Mode::MMIO)
+        return read (Arr32::LR, n);
+
+    switch (n) {
+        default:
+        case  0: return get_el2_lr0();
+        case  1: return get_el2_lr1();
+        case  2: return get_el2_lr2();
+        case  3: return get_el2_lr3();
+        case  4: return get_el2_lr4();
+        case  5: return get_el2_lr5();
+        case  6: return get_el2_lr6();
+        case  7: return get_el2_lr7();
+        case  8: return get_el2_lr8();
+        case  9: return get_el2_lr9();
+        case 10: return get_el2_lr10();
+        case 11: return get_el2_lr11();
+        case 12: return get_el2_lr12();
+        case 13: return get_el2_lr13();
+        case 14: return get_el2_lr14();
+        case 15: return get_el2_lr15();
+    }
+}
+
+void Gich::set_lr (unsigned n, uint64_t v)
+{
+    if (Gicc::mode == Gicc::Mode::MMIO)
+        return write (Arr32::LR, n, static_cast<uint32_t>(v));
+
+    switch (n) {
+        default:
+        case  0: return set_el2_lr0  (v);
+        case  1: return set_el2_lr1  (v);
+        case  2: return set_el2_lr2  (v);
+        case  3: return set_el2_lr3  (v);
+        case  4: return set_el2_lr4  (v);
+        case  5: return set_el2_lr5  (v);
+        case  6: return set_el2_lr6  (v);
+        case  7: return set_el2_lr7  (v);
+        case  8: return set_el2_lr8  (v);
+        case  9: return set_el2_lr9  (v);
+        case 10: return set_el2_lr10 (v);
+        case 11: return set_el2_lr11 (v);
+        case 12: return set_el2_lr12 (v);
+        case 13: return set_el2_lr13 (v);
+        case 14: return set_el2_lr14 (v);
+        case 15: return set_el2_lr15 (v);
+    }
+}
+
+/*
+ * Make a virtual interrupt pending in the list registers of the current vCPU
+ *
+ * @param id    Virtual INTID
+ * @param prio  Virtual priority
+ * @param hw    True if guest deactivation also deactivates the physical INTID of the same number
+ * @return      True if the interrupt is pending, false if no list register is free
+ */
+bool Gich::inject (unsigned id, uint8_t prio, bool hw)
+{
+    auto const mmio { Gicc::mode == Gicc::Mode::MMIO };
+
+    // List register layout: GICv2 (32 bits) or GICv3 (64 bits)
+    auto const pend { mmio ? BIT64 (28) : BIT64 (62) };
+    auto const vint { mmio ? BIT64_RANGE (9, 0) : BIT64_RANGE (31, 0) };
+
+    auto const elrsr { (mmio ? read (Reg32::ELRSR) : get_el2_elrsr()) & BIT_RANGE (min (num_lr, 16U) - 1, 0) };
+
+    unsigned free { ~0U };
+
+    for (unsigned i { 0 }; i < min (num_lr, 16U); i++) {
+
+        if (elrsr & BIT (i)) {
+            if (free == ~0U)
+                free = i;
+            continue;
+        }
+
+        // A vINTID must not occupy more than one list register
+        if (auto const lr { get_lr (i) }; (lr & vint) == id) {
+            if (!hw && !(lr & pend))
+                set_lr (i, lr | pend);
+            return true;
+        }
+    }
+
+    if (free == ~0U)
+        return false;
+
+    // Pending, Group 1
+    set_lr (free, mmio ? (hw ? BIT64 (31) | static_cast<uint64_t>(id) << 10 : 0) | BIT64 (30) | pend | static_cast<uint64_t>(prio >> 3) << 23 | id
+                       : (hw ? BIT64 (61) | static_cast<uint64_t>(id) << 32 : 0) | BIT64 (60) | pend | static_cast<uint64_t>(prio)      << 48 | id);
+
+    return true;
+}
+
+/*
+ * Determine if the list registers of the current vCPU hold a pending interrupt
+ *
+ * @return      True if an interrupt is pending, false otherwise
+ */
+bool Gich::pending()
+{
+    auto const mmio { Gicc::mode == Gicc::Mode::MMIO };
+    auto const pend { mmio ? BIT64 (28) : BIT64 (62) };
+    auto const elrsr { mmio ? read (Reg32::ELRSR) : get_el2_elrsr() };
+
+    for (unsigned i { 0 }; i < min (num_lr, 16U); i++)
+        if (!(elrsr & BIT (i)) && get_lr (i) & pend)
+            return true;
+
+    return false;
+}
+
+/*
+ * Control the underflow maintenance interrupt of the current vCPU
+ *
+ * @param e     True to request a maintenance interrupt when the list registers drain, false otherwise
+ */
+void Gich::set_uie (bool e)
+{
+    if (Gicc::mode == Gicc::Mode::MMIO) {
+        auto const hcr { read (Reg32::HCR) };
+        write (Reg32::HCR, e ? hcr | BIT (1) : hcr & ~BIT (1));
+    } else {
+        auto const hcr { get_el2_hcr() };
+        set_el2_hcr (e ? hcr | BIT (1) : hcr & ~BIT (1));
+        Barrier::isb();
+    }
+}
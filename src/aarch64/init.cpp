@@ -58,10 +58,10 @@ extern "C" unsigned init()
     Acpi::init() || Fdt::init();
 
     // If SMMUs were not enumerated by firmware, then enumerate them based on board knowledge
-    if (!Smmu::avail_smg() && !Smmu::avail_ctx())
+    if (!Smmu::present())
         for (unsigned i = 0; i < sizeof (Board::smmu) / sizeof (*Board::smmu); i++)
             if (Board::smmu[i].mmio)
-                new Smmu (Board::smmu[i]);
+                new Smmu (Smmu::describe (Board::smmu[i]));
 
     return Cpu::boot_cpu;
 }
@@ -20,6 +20,7 @@
 #include "counter.hpp"
 #include "gicc.hpp"
 #include "gicd.hpp"
+#include "gich.hpp"
 #include "gicr.hpp"
 #include "interrupt.hpp"
 #include "sm.hpp"
@@ -55,6 +56,7 @@ Event::Selector Interrupt::handle_sgi (uint32_t val, bool)
     switch (sgi) {
         case Request::RRQ: Scheduler::requeue(); break;
         case Request::RKE: rke_handler(); break;
+        case Request::RCL: Ec::handle_claims(); break;
     }
 
     Gicc::dir (val);
@@ -78,6 +80,9 @@ Event::Selector Interrupt::handle_ppi (uint32_t val, bool vcpu)
     if (ppi == Timer::ppi_el2_p)        // Deactivation by host
         Timeout::check();
 
+    if (ppi == Gich::ppi_mnt)           // List registers are refilled on guest entry
+        Gich::set_uie (false);
+
     Gicc::dir (val);
 
     return Event::Selector::NONE;
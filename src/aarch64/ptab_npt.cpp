@@ -31,5 +31,9 @@ void Nptp::init()
     // IPA cannot be larger than OAS supported by CPU
     assert (Npt::ibits <= Npt::pas (oas));
 
-    asm volatile ("msr vtcr_el2, %x0; isb" : : "rZ" (VTCR_RES1 | oas << 16 | TCR_TG0_4K | TCR_SH0_INNER | TCR_ORGN0_WB_RW | TCR_IRGN0_WB_RW | (Npt::lev() - 2) << 6 | (64 - Npt::ibits)) : "memory");
+    // Use 16-bit VMIDs only if all CPUs support them
+    if (Cpu::feature (Cpu::Mem_feature::VMIDBITS) != 2)
+        Vmid::narrow();
+
+    asm volatile ("msr vtcr_el2, %x0; isb" : : "rZ" (VTCR_RES1 | Vmid::wide() * VTCR_VS | oas << 16 | TCR_TG0_4K | TCR_SH0_INNER | TCR_ORGN0_WB_RW | TCR_IRGN0_WB_RW | (Npt::lev() - 2) << 6 | (64 - Npt::ibits)) : "memory");
 }
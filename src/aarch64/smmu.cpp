@@ -15,7 +15,9 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "barrier.hpp"
 #include "bits.hpp"
+#include "cache.hpp"
 #include "hip.hpp"
 #include "interrupt.hpp"
 #include "lock_guard.hpp"
@@ -24,18 +26,24 @@
 #include "space_dma.hpp"
 #include "space_hst.hpp"
 #include "stdio.hpp"
+#include "wait.hpp"
 
 INIT_PRIORITY (PRIO_SLAB) Slab_cache Smmu::cache { sizeof (Smmu), alignof (Smmu) };
 
-Smmu::Smmu (Board::Smmu const &brd) : List (list), board (brd)
+Smmu::Smmu (Desc const &d) : List (list), arch (d.arch), desc (d)
 {
     // Map first SMMU page
-    Hptp::master_map (mmap, board.mmio, 0,
+    Hptp::master_map (mmap, desc.mmio, 0,
                       Paging::Permissions (Paging::G | Paging::W | Paging::R), Memattr::dev());
 
     // This facilitates access to the GR0 register space only
     mmio_base_gr0 = mmap;
 
+    if (arch == Arch::SMMUv3) {
+        probe_v3();
+        return;
+    }
+
     auto const idr0 { read (GR0_Reg32::IDR0) };
     auto const idr1 { read (GR0_Reg32::IDR1) };
     auto const idr2 { read (GR0_Reg32::IDR2) };
@@ -58,7 +66,7 @@ Smmu::Smmu (Board::Smmu const &brd) : List (list), board (brd)
     auto const smmu_size { page_size * smmu_pnum * 2 };
 
     // Map all SMMU pages
-    Hptp::master_map (mmap, board.mmio, static_cast<unsigned>(bit_scan_msb (smmu_size)) - PAGE_BITS,
+    Hptp::master_map (mmap, desc.mmio, static_cast<unsigned>(bit_scan_msb (smmu_size)) - PAGE_BITS,
                       Paging::Permissions (Paging::G | Paging::W | Paging::R), Memattr::dev());
 
     // This facilitates access to the GR1 and CTX register spaces
@@ -69,12 +77,12 @@ Smmu::Smmu (Board::Smmu const &brd) : List (list), board (brd)
     config = new Config;
 
     trace (TRACE_SMMU, "SMMU: %#010lx %#x r%up%u S1:%u S2:%u N:%u C:%u SMG:%u CTX:%u SID:%u-bit Mode:%u",
-           board.mmio, smmu_size, idr7 >> 4 & BIT_RANGE (3, 0), idr7 & BIT_RANGE (3, 0),
+           desc.mmio, smmu_size, idr7 >> 4 & BIT_RANGE (3, 0), idr7 & BIT_RANGE (3, 0),
            !!(idr0 & BIT (30)), !!(idr0 & BIT (29)), !!(idr0 & BIT (28)), !!(idr0 & BIT (14)),
            num_smg, num_ctx, sidx_bits, std::to_underlying (mode));
 
     // Reserve MMIO region
-    Space_hst::access_ctrl (board.mmio, smmu_size, Paging::NONE);
+    Space_hst::access_ctrl (desc.mmio, smmu_size, Paging::NONE);
 
     // Advance memory map pointer
     mmap += smmu_size;
@@ -82,17 +90,42 @@ Smmu::Smmu (Board::Smmu const &brd) : List (list), board (brd)
     Hip::set_feature (Hip_arch::Feature::SMMU);
 }
 
+/*
+ * Describe an SMMU from the board, which only lists SMMUv2 instances
+ *
+ * @param b     Board description
+ * @return      SMMU description
+ */
+Smmu::Desc Smmu::describe (Board::Smmu const &b)
+{
+    static_assert (sizeof (b.glb) / sizeof (*b.glb) <= sizeof (Desc::glb) / sizeof (*Desc::glb));
+    static_assert (sizeof (b.ctx) / sizeof (*b.ctx) <= sizeof (Desc::ctx) / sizeof (*Desc::ctx));
+
+    Desc d { .mmio = b.mmio, .arch = Arch::SMMUv2 };
+
+    for (unsigned i { 0 }; i < sizeof (b.glb) / sizeof (*b.glb); i++)
+        d.glb[i] = { b.glb[i].spi, b.glb[i].flg };
+
+    for (unsigned i { 0 }; i < sizeof (b.ctx) / sizeof (*b.ctx); i++)
+        d.ctx[i] = { b.ctx[i].spi, b.ctx[i].flg };
+
+    return d;
+}
+
 void Smmu::init()
 {
     // Configure global fault interrupts
-    for (unsigned i { 0 }; i < sizeof (board.glb) / sizeof (*board.glb); i++)
-        if (board.glb[i].flg)
-            Interrupt::conf_spi (board.glb[i].spi, false, board.glb[i].flg & BIT_RANGE (3, 2), Cpu::id);
+    for (unsigned i { 0 }; i < sizeof (desc.glb) / sizeof (*desc.glb); i++)
+        if (desc.glb[i].flg)
+            Interrupt::conf_spi (desc.glb[i].spi, false, desc.glb[i].flg & BIT_RANGE (3, 2), Cpu::id);
 
     // Configure context fault interrupts
-    for (unsigned i { 0 }; i < sizeof (board.ctx) / sizeof (*board.ctx); i++)
-        if (board.ctx[i].flg)
-            Interrupt::conf_spi (board.ctx[i].spi, false, board.ctx[i].flg & BIT_RANGE (3, 2), Cpu::id);
+    for (unsigned i { 0 }; i < sizeof (desc.ctx) / sizeof (*desc.ctx); i++)
+        if (desc.ctx[i].flg)
+            Interrupt::conf_spi (desc.ctx[i].spi, false, desc.ctx[i].flg & BIT_RANGE (3, 2), Cpu::id);
+
+    if (arch == Arch::SMMUv3)
+        return init_v3();
 
     // Configure CTXs
     for (uint8_t ctx { 0 }; ctx < num_ctx; ctx++)
@@ -155,6 +188,27 @@ bool Smmu::configure (Space_dma *dma, uintptr_t dad)
     auto       smg { static_cast<uint8_t> (dad >> 32) };
     auto const ctx { static_cast<uint8_t> (dad >> 40) };
 
+    // SMMUv3 has an STE for each SID and ignores SMG and CTX
+    if (arch == Arch::SMMUv3) {
+
+        if (!ready || (sid | msk) >= BIT (sidx_bits))
+            return false;
+
+        trace (TRACE_SMMU, "SMMU: SID:%#06x MSK:%#06x assigned to Domain %u", sid, msk, static_cast<unsigned>(dma->get_sdid()));
+
+        Lock_guard <Spinlock> guard { cfg_lock };
+
+        // Configure each SID matched by the masked SID
+        for (unsigned s { 0 };; s = (s - msk) & msk) {
+
+            if (!conf_ste (static_cast<uint16_t>((sid & ~msk) | s), dma))
+                return false;
+
+            if (s == msk)
+                return true;
+        }
+    }
+
     // When using stream indexing, the maximum SID size is 7 bits and selects the SMG directly
     if (mode == Mode::STREAM_INDEXING)
         smg = static_cast<uint8_t>(sid);
@@ -177,6 +231,9 @@ bool Smmu::configure (Space_dma *dma, uintptr_t dad)
 
 void Smmu::fault()
 {
+    if (arch == Arch::SMMUv3)
+        return fault_v3();
+
     auto const gfsr { read (GR0_Reg32::GFSR) };
 
     if (gfsr & BIT_RANGE (8, 0)) {
@@ -269,3 +326,425 @@ void Smmu::tlb_sync_glb()
     while (read (GR0_Reg32::TLBGSTATUS) & BIT (0))
         pause();
 }
+
+/*
+ * Post TLB invalidation for a DMA range, without waiting for completion
+ *
+ * SMMUv2 invalidates the entire VMID, because the range may be mapped by multiple context banks.
+ */
+void Smmu::tlb_invalidate_post (Sdid s, uint64_t a, unsigned o)
+{
+    if (arch == Arch::SMMUv2) {
+        write (GR0_Reg32::TLBIVMID, s & BIT_RANGE (15, 0));
+        return;
+    }
+
+    if (!ready)
+        return;
+
+    auto const vmid { static_cast<uint64_t>(s) << 32 };
+
+    a &= ~OFFS_MASK (0) << o;
+
+    Lock_guard <Spinlock> guard { inv_lock };
+
+    if (ril && o <= ipa_ord_range)
+        cmd_post (Cmd::TLBI_S2_IPA, vmid | static_cast<uint64_t>(o) << 20, a | BIT (10));   // NUM=0, SCALE=o, TG=4KiB
+
+    else if (o <= ipa_ord_page)
+        for (uint64_t p { 0 }; p < BIT64 (o); p++)
+            cmd_post (Cmd::TLBI_S2_IPA, vmid, a + (p << PAGE_BITS));
+
+    else
+        cmd_post (Cmd::TLBI_S12_VMALL, vmid);
+
+    cmd_sync();
+}
+
+/*
+ * Wait for completion of all posted TLB invalidations
+ */
+void Smmu::tlb_wait()
+{
+    if (arch == Arch::SMMUv2)
+        tlb_sync_glb();
+
+    else if (ready && !cmd_wait())
+        panic ("SMMU: TLB invalidation timed out");
+}
+
+/*
+ * Determine SMMUv3 capabilities and allocate the stream table and queues
+ */
+void Smmu::probe_v3()
+{
+    // Map both SMMU register pages
+    auto const smmu_size { BIT (17) };
+
+    Hptp::master_map (mmap, desc.mmio, 17 - PAGE_BITS,
+                      Paging::Permissions (Paging::G | Paging::W | Paging::R), Memattr::dev());
+
+    // This facilitates access to register page 1
+    mmio_base_gr1 = mmio_base_gr0 + BIT (16);
+
+    auto const idr0 { read (V3_Reg32::IDR0) };
+    auto const idr1 { read (V3_Reg32::IDR1) };
+    auto const idr3 { read (V3_Reg32::IDR3) };
+    auto const idr5 { read (V3_Reg32::IDR5) };
+    auto const aidr { read (V3_Reg32::AIDR) };
+
+    // Determine SMMU capabilities; SIDs beyond 16 bits cannot be assigned
+    sidx_bits   = min (idr1 & BIT_RANGE (5, 0), 16U);
+    strtab_2lvl = (idr0 >> 27 & BIT_RANGE (1, 0)) == 1 && sidx_bits > strtab_split;
+    ril         = idr3 & BIT (10);
+    cmdq_bits   = static_cast<uint8_t>(min (idr1 >> 21 & BIT_RANGE (4, 0), PAGE_BITS - 4U));  // 16-byte commands
+    evtq_bits   = static_cast<uint8_t>(min (idr1 >> 16 & BIT_RANGE (4, 0), PAGE_BITS - 5U));  // 32-byte events
+    ias = oas   = BIT_RANGE (2, 0) & idr5;
+
+    // Treat DPT as noncoherent if at least one SMMU requires it
+    Dpt::noncoherent |= !(idr0 & BIT (4));
+
+    trace (TRACE_SMMU, "SMMU: %#010lx %#x v3.%u S1:%u S2:%u C:%u SID:%u-bit ST:%s CMDQ:%u EVTQ:%u RIL:%u",
+           desc.mmio, smmu_size, aidr & BIT_RANGE (3, 0),
+           !!(idr0 & BIT (1)), !!(idr0 & BIT (0)), !!(idr0 & BIT (4)),
+           sidx_bits, strtab_2lvl ? "2-level" : "linear", BIT (cmdq_bits), BIT (evtq_bits), ril);
+
+    // Allocate stream table and queues, if the SMMU supports stage-2 translation with 4KiB granule
+    if (idr0 & BIT (0) && idr5 & BIT (4) && cmdq_bits && evtq_bits) {
+
+        auto const st { static_cast<uint64_t *>(Buddy::alloc (static_cast<uint8_t>(bit_scan_msb (max (strtab_size(), PAGE_SIZE (0))) - PAGE_BITS), Buddy::Fill::BITS0)) };
+        auto const cq { static_cast<uint64_t *>(Buddy::alloc (0, Buddy::Fill::BITS0)) };
+        auto const eq { static_cast<uint64_t *>(Buddy::alloc (0, Buddy::Fill::BITS0)) };
+
+        if (EXPECT_TRUE (st && cq && eq)) {
+            strtab = st;
+            cmdq   = cq;
+            evtq   = eq;
+        }
+    }
+
+    // Reserve MMIO region
+    Space_hst::access_ctrl (desc.mmio, smmu_size, Paging::NONE);
+
+    // Advance memory map pointer
+    mmap += smmu_size;
+
+    Hip::set_feature (Hip_arch::Feature::SMMU);
+}
+
+/*
+ * Program the SMMUv3 stream table and queues, then enable translation
+ */
+void Smmu::init_v3()
+{
+    if (!strtab)
+        return;
+
+    ready = false;
+
+    auto const enable { [this] (uint32_t v)
+    {
+        write (V3_Reg32::CR0, v);
+
+        return Wait::until (timeout, [&] { return read (V3_Reg32::CR0ACK) == v; });
+    } };
+
+    auto const failed { [this] (char const *s)
+    {
+        trace (TRACE_SMMU, "SMMU: %#010lx %s timed out", desc.mmio, s);
+    } };
+
+    // Disable SMMU during configuration
+    if (EXPECT_FALSE (!enable (0)))
+        return failed ("Disable");
+
+    // Tables and queues were initialized through the CPU cache
+    if (Dpt::noncoherent) {
+        Cache::data_clean (strtab, strtab_size());
+        Cache::data_clean (cmdq, PAGE_SIZE (0));
+        Cache::data_clean (evtq, PAGE_SIZE (0));
+    }
+
+    // Table and queue accesses: Inner Shareable, WB cacheable or Non-cacheable
+    write (V3_Reg32::CR1, Dpt::noncoherent ? 0 : BIT_RANGE (11, 10) | BIT (8) | BIT (6) | BIT_RANGE (5, 4) | BIT (2) | BIT (0));
+    write (V3_Reg32::CR2, BIT (1));     // Record C_BAD_STREAMID events
+
+    write (V3_Reg64::STRTAB_BASE, BIT64 (62) | Kmem::ptr_to_phys (strtab));
+    write (V3_Reg32::STRTAB_CFG,  strtab_2lvl ? BIT (16) | strtab_split << 6 | sidx_bits : sidx_bits);
+
+    write (V3_Reg64::CMDQ_BASE, BIT64 (62) | Kmem::ptr_to_phys (cmdq) | cmdq_bits);
+    write (V3_Reg32::CMDQ_PROD, 0);
+    write (V3_Reg32::CMDQ_CONS, 0);
+
+    cmdq_tail = cmdq_prod = 0;
+
+    write (V3_Reg64::EVTQ_BASE, BIT64 (62) | Kmem::ptr_to_phys (evtq) | evtq_bits);
+    write (V3_Pg1_32::EVTQ_PROD, 0);
+    write (V3_Pg1_32::EVTQ_CONS, 0);
+
+    if (EXPECT_FALSE (!enable (BIT (3))))
+        return failed ("CMDQ enable");
+
+    // Invalidate cached configuration and TLB entries
+    {   Lock_guard <Spinlock> guard { inv_lock };
+
+        cmd_post (Cmd::CFGI_ALL, 0, BIT_RANGE (4, 0));
+        cmd_post (Cmd::TLBI_NSNH_ALL);
+        cmd_sync();
+    }
+
+    if (EXPECT_FALSE (!cmd_wait()))
+        return failed ("CMDQ");
+
+    if (EXPECT_FALSE (!enable (BIT (3) | BIT (2))))
+        return failed ("EVTQ enable");
+
+    // Enable event queue and global error interrupts
+    write (V3_Reg32::IRQ_CTRL, BIT (2) | BIT (0));
+
+    if (EXPECT_FALSE (!Wait::until (timeout, [&] { return read (V3_Reg32::IRQ_CTRLACK) == (BIT (2) | BIT (0)); })))
+        return failed ("IRQ enable");
+
+    if (EXPECT_FALSE (!enable (BIT (3) | BIT (2) | BIT (0))))
+        return failed ("SMMU enable");
+
+    ready = true;
+}
+
+/*
+ * Locate the STE for a SID, allocating its level-2 stream table if necessary
+ *
+ * @param sid   Stream ID
+ * @return      Pointer to the STE (or nullptr if out of memory)
+ */
+uint64_t *Smmu::ste (uint16_t sid)
+{
+    if (!strtab_2lvl)
+        return strtab + sid * 8;
+
+    auto &l1 { strtab[sid >> strtab_split] };
+
+    if (!l1) {
+
+        auto const l2 { Buddy::alloc (0, Buddy::Fill::BITS0) };
+
+        if (EXPECT_FALSE (!l2))
+            return nullptr;
+
+        if (Dpt::noncoherent)
+            Cache::data_clean (l2, PAGE_SIZE (0));
+
+        // L2Ptr, Span
+        l1 = Kmem::ptr_to_phys (l2) | (strtab_split + 1);
+
+        if (Dpt::noncoherent)
+            Cache::data_clean (&l1);
+    }
+
+    return static_cast<uint64_t *>(Kmem::phys_to_ptr (l1 & BIT64_RANGE (51, 6))) + (sid & BIT_RANGE (strtab_split - 1, 0)) * 8;
+}
+
+/*
+ * Configure the STE for a SID as stage-2 translation through the DMA space
+ *
+ * @param sid   Stream ID
+ * @param dma   DMA space
+ * @return      true if successful, false otherwise
+ */
+bool Smmu::conf_ste (uint16_t sid, Space_dma *dma)
+{
+    auto const e { ste (sid) };
+
+    if (EXPECT_FALSE (!e))
+        return false;
+
+    auto const sdid { dma->get_sdid() };
+
+    // Disable STE during configuration
+    if (e[0] & BIT64 (0)) {
+
+        e[0] = 0;
+
+        if (Dpt::noncoherent)
+            Cache::data_clean (e);
+
+        {   Lock_guard <Spinlock> guard { inv_lock };
+
+            cmd_post (Cmd::CFGI_STE, static_cast<uint64_t>(sid) << 32);
+            cmd_sync();
+        }
+
+        if (EXPECT_FALSE (!cmd_wait()))
+            return false;
+    }
+
+    // Determine input size and number of levels
+    auto const isz { Dpt::pas (ias) };
+    auto const lev { Dpt::lev (isz) };
+
+    // Configure STE as stage-1 bypass, stage-2 translate
+    e[1] = BIT64 (44);                                                                  // SHCFG: Incoming
+    e[2] = BIT64 (58) | BIT64 (54) | BIT64 (51) |                                       // S2R, S2PTW, S2AA64
+           static_cast<uint64_t>(oas) << 48 |                                           // S2PS
+           VAL64_SHIFT (3, 44) | VAL64_SHIFT (1, 42) | VAL64_SHIFT (1, 40) |            // S2SH0, S2OR0, S2IR0, S2TG=4KiB
+           static_cast<uint64_t>(lev - 2) << 38 | static_cast<uint64_t>(64 - isz) << 32 | sdid;
+    e[3] = Kmem::ptr_to_phys (dma->get_ptab (lev - 1)) & BIT64_RANGE (51, 4);
+
+    Barrier::wmb (Barrier::Domain::ISH);
+
+    // Enable STE
+    e[0] = VAL64_SHIFT (6, 1) | BIT64 (0);
+
+    if (Dpt::noncoherent)
+        Cache::data_clean (e, 8 * sizeof (*e));
+
+    // Invalidate cached STE and stale TLB entries for SDID
+    {   Lock_guard <Spinlock> guard { inv_lock };
+
+        cmd_post (Cmd::CFGI_STE, static_cast<uint64_t>(sid) << 32);
+        cmd_post (Cmd::TLBI_S12_VMALL, static_cast<uint64_t>(sdid) << 32);
+        cmd_sync();
+    }
+
+    return cmd_wait();
+}
+
+/*
+ * Write a command into the command queue, without publishing it to the SMMU
+ *
+ * The caller must hold inv_lock.
+ */
+void Smmu::cmd_post (Cmd c, uint64_t dw0, uint64_t dw1)
+{
+    // If the queue is full, publish pending commands and wait for space
+    if (cmdq_tail - cmd_cons() >= BIT64 (cmdq_bits)) {
+
+        cmd_publish();
+
+        // Overwriting unconsumed commands would lose invalidations
+        if (EXPECT_FALSE (!Wait::until (timeout, [&] { return cmdq_tail - cmd_cons() < BIT64 (cmdq_bits); })))
+            panic ("SMMU: Command queue stalled");
+    }
+
+    auto const e { cmdq + (cmdq_tail++ & (BIT64 (cmdq_bits) - 1)) * 2 };
+
+    e[0] = dw0 | std::to_underlying (c);
+    e[1] = dw1;
+
+    if (Dpt::noncoherent)
+        Cache::data_clean (e);
+}
+
+/*
+ * Publish all written commands to the SMMU
+ *
+ * The caller must hold inv_lock.
+ */
+void Smmu::cmd_publish()
+{
+    Barrier::wmb (Barrier::Domain::OSH);
+
+    cmdq_prod = cmdq_tail;
+
+    write (V3_Reg32::CMDQ_PROD, static_cast<uint32_t>(cmdq_prod & (BIT64 (cmdq_bits + 1) - 1)));
+}
+
+/*
+ * Append CMD_SYNC to the written commands and publish them to the SMMU
+ *
+ * The caller must hold inv_lock.
+ */
+void Smmu::cmd_sync()
+{
+    cmd_post (Cmd::SYNC);
+    cmd_publish();
+}
+
+/*
+ * Wait until the SMMU consumed all published commands, including the CMD_SYNC of the caller
+ *
+ * @return      true if successful, false if the SMMU did not consume them within the timeout
+ */
+bool Smmu::cmd_wait()
+{
+    Lock_guard <Spinlock> guard { inv_lock };
+
+    auto const p { cmdq_prod };
+
+    return Wait::until (timeout, [&] { return cmd_cons() >= p; });
+}
+
+/*
+ * Determine the number of consumed commands
+ *
+ * A command the SMMU rejected is replaced by CMD_SYNC, so that consumption resumes.
+ * The caller must hold inv_lock.
+ *
+ * @return      Number of commands consumed since the command queue was enabled
+ */
+uint64_t Smmu::cmd_cons()
+{
+    auto const cons { read (V3_Reg32::CMDQ_CONS) };
+
+    if ((read (V3_Reg32::GERROR) ^ read (V3_Reg32::GERRORN)) & BIT (0)) {
+
+        auto const e { cmdq + (cons & (BIT (cmdq_bits) - 1)) * 2 };
+
+        trace (TRACE_SMMU, "SMMU: %#010lx CMDQ Error %u for Command %#04x", desc.mmio, cons >> 24 & BIT_RANGE (6, 0), static_cast<unsigned>(e[0] & BIT_RANGE (7, 0)));
+
+        e[0] = std::to_underlying (Cmd::SYNC);
+        e[1] = 0;
+
+        if (Dpt::noncoherent)
+            Cache::data_clean (e);
+
+        Barrier::wmb (Barrier::Domain::OSH);
+
+        write (V3_Reg32::GERRORN, read (V3_Reg32::GERRORN) ^ BIT (0));
+    }
+
+    return cmdq_prod - ((cmdq_prod - cons) & (BIT64 (cmdq_bits + 1) - 1));
+}
+
+/*
+ * Report events from the event queue and global errors
+ */
+void Smmu::fault_v3()
+{
+    if (!strtab)
+        return;
+
+    auto const prod { read (V3_Pg1_32::EVTQ_PROD) };
+    auto       cons { read (V3_Pg1_32::EVTQ_CONS) };
+    auto const mask { BIT (evtq_bits + 1) - 1 };
+
+    Barrier::rmb (Barrier::Domain::OSH);
+
+    for (; (cons ^ prod) & mask; cons = (cons & ~mask) | ((cons + 1) & mask)) {
+
+        auto const e { evtq + (cons & (BIT (evtq_bits) - 1)) * 4 };
+
+        if (Dpt::noncoherent)
+            Cache::data_clean_invalidate (e);
+
+        trace (TRACE_SMMU, "SMMU: %#010lx Event %#04x SID:%#x at %#010lx (%c%c%c) S%u",
+               desc.mmio, static_cast<unsigned>(e[0] & BIT_RANGE (7, 0)), static_cast<unsigned>(e[0] >> 32), e[2],
+               e[1] & BIT64 (37) ? 'I' : 'D',   // Instruction / Data
+               e[1] & BIT64 (36) ? 'P' : 'U',   // Privileged / Unprivileged
+               e[1] & BIT64 (35) ? 'R' : 'W',   // Read / Write
+               e[1] & BIT64 (39) ? 2 : 1);      // Stage
+    }
+
+    // Free consumed entries and acknowledge overflow
+    write (V3_Pg1_32::EVTQ_CONS, (prod & BIT (31)) | (cons & mask));
+
+    Lock_guard <Spinlock> guard { inv_lock };
+
+    // Command queue errors are handled when waiting for command completion
+    auto const gerr { (read (V3_Reg32::GERROR) ^ read (V3_Reg32::GERRORN)) & BIT_RANGE (8, 1) };
+
+    if (gerr) {
+        trace (TRACE_SMMU, "SMMU: %#010lx GERROR:%#x", desc.mmio, gerr);
+        write (V3_Reg32::GERRORN, read (V3_Reg32::GERRORN) ^ gerr);
+    }
+}
@@ -56,6 +56,9 @@ void Utcb_arch::load (Mtd_arch const m, Cpu_regs const &c)
     if (!v)
         return;
 
+    // Registers may be newer than the VMCB
+    Vmcb::sync();
+
     if (m & Mtd_arch::Item::A32_SPSR) {
         a32.spsr_abt = v->a32.spsr_abt;
         a32.spsr_fiq = v->a32.spsr_fiq;
@@ -199,6 +202,9 @@ bool Utcb_arch::save (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) const
     if (!v)
         return true;
 
+    // Registers may be newer than the VMCB
+    Vmcb::sync();
+
     if (m & Mtd_arch::Item::A32_SPSR) {
         v->a32.spsr_abt = a32.spsr_abt;
         v->a32.spsr_fiq = a32.spsr_fiq;
@@ -298,6 +304,11 @@ bool Utcb_arch::save (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) const
         // GIC ELRSR and VMCR are read-only
     }
 
+    // Registers are older than the VMCB now
+    v->invalidate (m & (Mtd_arch::Item::A32_SPSR | Mtd_arch::Item::A32_DIH | Mtd_arch::Item::EL1_SP | Mtd_arch::Item::EL1_IDR | Mtd_arch::Item::EL1_ELR_SPSR |
+                        Mtd_arch::Item::EL1_ESR_FAR | Mtd_arch::Item::EL1_AFSR | Mtd_arch::Item::EL1_TTBR | Mtd_arch::Item::EL1_TCR | Mtd_arch::Item::EL1_MAIR |
+                        Mtd_arch::Item::EL1_VBAR | Mtd_arch::Item::EL2_HCR | Mtd_arch::Item::EL2_IDR));
+
     if (m & Mtd_arch::Item::SPACES)
         if (EXPECT_FALSE (!assign_spaces (c, obj)))
             return false;
@@ -15,13 +15,19 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "assert.hpp"
+#include "barrier.hpp"
+#include "bits.hpp"
 #include "cpu.hpp"
 #include "fpu.hpp"
 #include "gich.hpp"
 #include "timer.hpp"
+#include "util.hpp"
 #include "vmcb.hpp"
 
-Vmcb const *Vmcb::current { nullptr };
+uint64_t    Vmcb::ctx   { 0 };
+Vmcb *      Vmcb::stale { nullptr };
+bool        Vmcb::guest { false };
 
 void Vmcb::init()
 {
@@ -32,12 +38,25 @@ void Vmcb::init()
 
     Fpu::disable();
 
+    // Register state did not survive a reset
+    stale = nullptr;
+    ctx   = ctx + 1;
+
     load_hst();
 }
 
+/*
+ * Load the host EL2 configuration for running host EL0
+ *
+ * The EL1 state of the last vCPU stays in the registers, because host EL0
+ * does not use it, so that vCPU only needs its configuration reloaded.
+ */
 void Vmcb::load_hst()
 {
-    current = nullptr;
+    if (stale && guest)
+        stale->save_cfg();
+
+    guest = false;
 
     asm volatile ("msr cpacr_el1,       %x0" : : "rZ" (BIT64_RANGE (21, 20)));
     asm volatile ("msr mdscr_el1,       %x0" : : "rZ" (0));
@@ -52,23 +71,174 @@ void Vmcb::load_hst()
     Gich::disable();
 }
 
-void Vmcb::load_gst() const
+/*
+ * Prepare the registers for running this vCPU
+ *
+ * The EL1 state is only loaded if another vCPU ran since this vCPU was last
+ * loaded, and the EL2 configuration only if host EL0 ran since then.
+ */
+void Vmcb::make_current()
+{
+    if (EXPECT_FALSE (tag != ctx)) {
+        sync();
+        load_el1();
+        tag = ctx = ctx + 1;
+        load_cfg();
+    } else if (EXPECT_FALSE (!guest))
+        load_cfg();
+
+    // Load timer interrupt state
+    load_tmr();
+
+    guest = true;
+    stale = this;
+
+    if (EXPECT_FALSE (vint_word))
+        inject();
+}
+
+/*
+ * Post virtual interrupt for injection on the next guest entry
+ *
+ * @param id    Virtual INTID
+ * @param prio  Virtual priority
+ * @return      True if the interrupt was posted, false if it was posted already
+ */
+bool Vmcb::post (unsigned id, uint8_t prio)
+{
+    vint_prio[id] = prio;
+
+    if (vint_pend[id / 64].test_and_set (BIT64 (id % 64)))
+        return false;
+
+    vint_word |= BIT (id / 64);
+
+    // Order the posted interrupt before the check whether the vCPU is current (pairs with Ec_arch::make_current)
+    Barrier::fmb (Barrier::Domain::ISH);
+
+    return true;
+}
+
+/*
+ * Inject the virtual timer interrupt into the current vCPU
+ *
+ * The list register is linked to the physical PPI, which stays active until
+ * the guest deactivates the virtual interrupt.
+ *
+ * @return      True if NOVA delivered the interrupt, false if the VMM must deliver it
+ */
+bool Vmcb::inject_tmr()
+{
+    return vtm && Gich::inject (Intid::from_ppi (Timer::ppi_el1_v), tmr_prio, true);
+}
+
+/*
+ * Determine if WFI may block the current vCPU
+ *
+ * @param t     Absolute system time of the virtual timer deadline (or 0 if none)
+ * @return      True if no interrupt is pending, false otherwise
+ */
+bool Vmcb::wfi_block (uint64_t &t) const
+{
+    assert (stale == this && guest);
+
+    t = 0;
+
+    if (vint_word || Gich::pending())
+        return false;
+
+    uint64_t ctl, cval;
+    asm volatile ("mrs %x0, cntv_ctl_el0"   : "=r" (ctl));
+    asm volatile ("mrs %x0, cntv_cval_el0"  : "=r" (cval));
+
+    // Timer is disabled or masked, or its interrupt has not been deactivated yet
+    if ((ctl & BIT_RANGE (1, 0)) != BIT (0) || Interrupt::get_act_tmr())
+        return true;
+
+    // Timer condition is met
+    if (ctl & BIT (2))
+        return false;
+
+    // The deadline in system time would overflow
+    if (cval + tmr.cntvoff < cval)
+        return true;
+
+    t = cval + tmr.cntvoff;
+
+    return true;
+}
+
+/*
+ * Adapt the halt-polling window to the observed WFI duration
+ *
+ * The window grows while wakeups arrive shortly after the window, and
+ * shrinks once a WFI lasts longer than polling could ever cover.
+ *
+ * @param d     Duration of the WFI in ticks
+ */
+void Vmcb::adapt_poll (uint64_t d)
+{
+    auto const max { Stc::us_to_ticks (poll_max_us) };
+
+    // Polling covered the wakeup
+    if (d <= poll)
+        return;
+
+    if (d > max)
+        poll /= 2;
+    else if (poll < max)
+        poll = poll ? min (poll * 2, max) : Stc::us_to_ticks (poll_min_us);
+}
+
+/*
+ * Move posted virtual interrupts into free list registers
+ *
+ * Interrupts that do not fit remain posted and the underflow maintenance
+ * interrupt causes a VM exit once the guest has drained the list registers.
+ */
+void Vmcb::inject()
 {
-    current = this;
+    for (auto w { vint_word.fetch_and (0) }; w; w &= w - 1) {
+
+        auto const i { static_cast<unsigned>(bit_scan_lsb (w)) };
+
+        for (auto p { vint_pend[i].load() }; p; p &= p - 1) {
+
+            auto const b { static_cast<unsigned>(bit_scan_lsb (p)) }, id { i * 64 + b };
+
+            if (EXPECT_FALSE (!Gich::inject (id, vint_prio[id]))) {
+                vint_word |= w;
+                Gich::set_uie (true);
+                return;
+            }
 
+            vint_pend[i].test_and_clr (BIT64 (b));
+        }
+    }
+
+    Gich::set_uie (false);
+}
+
+void Vmcb::adjust_cntvoff (uint64_t t)
+{
+    tmr.cntvoff += t;
+
+    if (tag == ctx && guest)
+        asm volatile ("msr cntvoff_el2,     %x0" : : "r" (Timer::syst_to_phys (tmr.cntvoff)));
+}
+
+void Vmcb::load_el1() const
+{
     asm volatile ("msr afsr0_el1,       %x0" : : "r" (el1.afsr0));
     asm volatile ("msr afsr1_el1,       %x0" : : "r" (el1.afsr1));
     asm volatile ("msr amair_el1,       %x0" : : "r" (el1.amair));
     asm volatile ("msr contextidr_el1,  %x0" : : "r" (el1.contextidr));
-    asm volatile ("msr cpacr_el1,       %x0" : : "r" (el1.cpacr));
     asm volatile ("msr csselr_el1,      %x0" : : "r" (el1.csselr));
     asm volatile ("msr elr_el1,         %x0" : : "r" (el1.elr));
     asm volatile ("msr esr_el1,         %x0" : : "r" (el1.esr));
     asm volatile ("msr far_el1,         %x0" : : "r" (el1.far));
     asm volatile ("msr mair_el1,        %x0" : : "r" (el1.mair));
-    asm volatile ("msr mdscr_el1,       %x0" : : "r" (el1.mdscr));
     asm volatile ("msr par_el1,         %x0" : : "r" (el1.par));
-    asm volatile ("msr sctlr_el1,       %x0" : : "r" (el1.sctlr));
     asm volatile ("msr sp_el1,          %x0" : : "r" (el1.sp));
     asm volatile ("msr spsr_el1,        %x0" : : "r" (el1.spsr));
     asm volatile ("msr tcr_el1,         %x0" : : "r" (el1.tcr));
@@ -77,7 +247,6 @@ void Vmcb::load_gst() const
     asm volatile ("msr ttbr1_el1,       %x0" : : "r" (el1.ttbr1));
     asm volatile ("msr vbar_el1,        %x0" : : "r" (el1.vbar));
 
-    asm volatile ("msr hcr_el2,         %x0" : : "r" (el2.hcr));
 //  asm volatile ("msr vdisr_el2,       %x0" : : "r" (el2.vdisr));   // RAS
     asm volatile ("msr vmpidr_el2,      %x0" : : "r" (el2.vmpidr));
     asm volatile ("msr vpidr_el2,       %x0" : : "r" (el2.vpidr));
@@ -91,9 +260,18 @@ void Vmcb::load_gst() const
         asm volatile ("msr spsr_irq,    %x0" : : "r" (a32.spsr_irq));
         asm volatile ("msr spsr_und,    %x0" : : "r" (a32.spsr_und));
     }
+}
 
-    // Load timer interrupt state
-    load_tmr();
+/*
+ * Load the state that load_hst() overwrites
+ */
+void Vmcb::load_cfg() const
+{
+    asm volatile ("msr cpacr_el1,       %x0" : : "r" (el1.cpacr));
+    asm volatile ("msr mdscr_el1,       %x0" : : "r" (el1.mdscr));
+    asm volatile ("msr sctlr_el1,       %x0" : : "r" (el1.sctlr));
+
+    asm volatile ("msr hcr_el2,         %x0" : : "r" (el2.hcr));
 
     // Load timer register state
     asm volatile ("msr cntvoff_el2,     %x0" : : "r" (Timer::syst_to_phys (tmr.cntvoff)));
@@ -104,21 +282,18 @@ void Vmcb::load_gst() const
     Gich::load (gic.lr, gic.ap0r, gic.ap1r, gic.hcr, gic.vmcr);
 }
 
-void Vmcb::save_gst()
+void Vmcb::save_el1()
 {
     asm volatile ("mrs %x0, afsr0_el1"      : "=r" (el1.afsr0));
     asm volatile ("mrs %x0, afsr1_el1"      : "=r" (el1.afsr1));
     asm volatile ("mrs %x0, amair_el1"      : "=r" (el1.amair));
     asm volatile ("mrs %x0, contextidr_el1" : "=r" (el1.contextidr));
-    asm volatile ("mrs %x0, cpacr_el1"      : "=r" (el1.cpacr));
     asm volatile ("mrs %x0, csselr_el1"     : "=r" (el1.csselr));
     asm volatile ("mrs %x0, elr_el1"        : "=r" (el1.elr));
     asm volatile ("mrs %x0, esr_el1"        : "=r" (el1.esr));
     asm volatile ("mrs %x0, far_el1"        : "=r" (el1.far));
     asm volatile ("mrs %x0, mair_el1"       : "=r" (el1.mair));
-    // mdscr_el1 is trapped to the VMM by MDCR_TDE
     asm volatile ("mrs %x0, par_el1"        : "=r" (el1.par));
-    asm volatile ("mrs %x0, sctlr_el1"      : "=r" (el1.sctlr));
     asm volatile ("mrs %x0, sp_el1"         : "=r" (el1.sp));
     asm volatile ("mrs %x0, spsr_el1"       : "=r" (el1.spsr));
     asm volatile ("mrs %x0, tcr_el1"        : "=r" (el1.tcr));
@@ -127,7 +302,6 @@ void Vmcb::save_gst()
     asm volatile ("mrs %x0, ttbr1_el1"      : "=r" (el1.ttbr1));
     asm volatile ("mrs %x0, vbar_el1"       : "=r" (el1.vbar));
 
-    asm volatile ("mrs %x0, hpfar_el2"      : "=r" (el2.hpfar));
 //  asm volatile ("mrs %x0, vdisr_el2"      : "=r" (el2.vdisr));    // RAS
 
     if (EXPECT_FALSE (!(el2.hcr & HCR_RW))) {
@@ -139,9 +313,18 @@ void Vmcb::save_gst()
         asm volatile ("mrs %x0, spsr_irq"   : "=r" (a32.spsr_irq));
         asm volatile ("mrs %x0, spsr_und"   : "=r" (a32.spsr_und));
     }
+}
+
+/*
+ * Save the state that load_hst() overwrites
+ */
+void Vmcb::save_cfg()
+{
+    asm volatile ("mrs %x0, cpacr_el1"      : "=r" (el1.cpacr));
+    // mdscr_el1 is trapped to the VMM by MDCR_TDE
+    asm volatile ("mrs %x0, sctlr_el1"      : "=r" (el1.sctlr));
 
-    // Save timer interrupt state
-    save_tmr();
+    asm volatile ("mrs %x0, hpfar_el2"      : "=r" (el2.hpfar));
 
     // Save timer register state
     asm volatile ("mrs %x0, cntkctl_el1"    : "=r" (tmr.cntkctl));
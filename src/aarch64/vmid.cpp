@@ -0,0 +1,139 @@
+/*
+ * Virtual-Machine Identifier (VMID)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "cpu.hpp"
+#include "lock_guard.hpp"
+#include "vmid.hpp"
+
+uint64_t            Vmid::map[BIT (gen_shift) / 64] { BIT64 (0) };
+Atomic<uint64_t>    Vmid::active;
+uint64_t            Vmid::reserved;
+
+/*
+ * Find a free VMID in the current generation
+ *
+ * @param v     VMID to start searching from
+ * @return      Free VMID or 0 if all VMIDs are in use
+ */
+uint16_t Vmid::find (uint16_t v)
+{
+    for (unsigned i { v }; i < BIT (bits); i++)
+        if (!(map[i / 64] & BIT64 (i % 64)))
+            return static_cast<uint16_t>(i);
+
+    return 0;
+}
+
+/*
+ * Start a new generation (with the lock held)
+ */
+void Vmid::rollover()
+{
+    gen += BIT64 (gen_shift);
+
+    for (auto &m : map)
+        m = 0;
+
+    // VMID 0 is never assigned
+    map[0] = BIT64 (0);
+
+    // Keep the VMIDs that are active on some CPU
+    if (Cpu::all_online())
+        for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++) {
+
+            uint64_t v, n { 0 };
+
+            Kmem::loc_to_glob (cpu, &active)->exchange (v, n);
+
+            auto &r { *Kmem::loc_to_glob (cpu, &reserved) };
+
+            if (!v)
+                v = r;
+
+            if (v)
+                tas (static_cast<uint16_t>(v));
+
+            r = v;
+        }
+
+    // Invalidate stage-1 and stage-2 TLB entries of all VMIDs
+    asm volatile ("tlbi alle1is; dsb ish; isb" : : : "memory");
+}
+
+/*
+ * Assign a VMID in the current generation (with the lock held)
+ *
+ * @param t     Previous tag (generation and VMID) or 0 if unassigned
+ * @return      New tag
+ */
+uint64_t Vmid::alloc (uint64_t t)
+{
+    if (t) {
+
+        auto const v { static_cast<uint16_t>(t) };
+        auto const n { gen | v };
+        auto keep { false };
+
+        // A VMID reserved across the rollover stays with its owner
+        if (Cpu::all_online())
+            for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++)
+                if (auto &r { *Kmem::loc_to_glob (cpu, &reserved) }; r == t) {
+                    r    = n;
+                    keep = true;
+                }
+
+        // Otherwise reuse the previous VMID if it is still free
+        if (keep || !tas (v))
+            return n;
+    }
+
+    auto v { find (next) };
+
+    if (EXPECT_FALSE (!v)) {
+        rollover();
+        v = find (1);
+    }
+
+    tas (v);
+
+    next = static_cast<uint16_t>(v + 1);
+
+    return gen | v;
+}
+
+/*
+ * Obtain a VMID that is valid in the current generation and mark it active on this CPU
+ *
+ * @return      VMID
+ */
+uint16_t Vmid::get()
+{
+    uint64_t t { tag }, a { active };
+
+    // Fast path: the tag is current and no rollover has happened since this CPU last switched
+    if (EXPECT_TRUE (!((t ^ gen) >> gen_shift) && a && active.compare_exchange_n (a, t)))
+        return static_cast<uint16_t>(t);
+
+    Lock_guard <Spinlock> guard { lock };
+
+    if ((t = tag) >> gen_shift != gen >> gen_shift)
+        tag = t = alloc (t);
+
+    active = t;
+
+    return static_cast<uint16_t>(t);
+}
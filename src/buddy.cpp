@@ -22,13 +22,18 @@
 #include "assert.hpp"
 #include "bits.hpp"
 #include "buddy.hpp"
+#include "counter.hpp"
+#include "cpu.hpp"
 #include "extern.hpp"
 #include "kmem.hpp"
 #include "lock_guard.hpp"
 #include "multiboot.hpp"
 #include "string.hpp"
 
-Buddy::Waitlist Buddy::waitlist;
+Buddy::Waitlist  Buddy::waitlist;
+Buddy::Cachelist Buddy::cachelist;
+Buddy::Cachelist Buddy::zerolist;
+unsigned         Buddy::flushed;
 
 /*
  * Initialize the buddy allocator
@@ -48,66 +53,256 @@ void Buddy::init()
         free (reinterpret_cast<void *>(i));
 }
 
+/*
+ * Partition the memory pool into per-node zones
+ *
+ * Blocks must not span nodes, so all free blocks are broken up into pages,
+ * which are then coalesced again within their node.
+ */
+void Buddy::rezone()
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    Queue<Block> list;
+
+    // Take all free blocks off the freelists
+    for (auto &f : freelist) {
+        for (auto o { orders }; o--; ) {
+            for (Block *b; (b = f.dequeue (o)); list.enqueue_tail (b)) {
+
+                // Hide the block and its pages from coalescing
+                for (unsigned i { 0 }; i < BIT (o); i++)
+                    b[i].tag = Block::Tag::USED;
+            }
+        }
+    }
+
+    // Assign each page to its node
+    for (auto i { min_idx }; i < max_idx; i++)
+        index_to_block (i)->node = Numa::memory (Kmem::ptr_to_phys (reinterpret_cast<void *>(index_to_page (i))));
+
+    // Free the pages of all blocks again
+    for (Block *b; (b = list.dequeue_head()); ) {
+
+        auto const n { BIT (b->ord) };
+
+        for (unsigned i { 0 }; i < n; i++) {
+            b[i].ord = 0;
+            coalesce (b + i);
+        }
+    }
+}
+
+/*
+ * Count an acquisition of the allocator lock
+ *
+ * CPU-local memory is not mapped while cores are booting or resuming,
+ * which includes Buddy::init, so the counter is skipped until then.
+ */
+void Buddy::count_lock()
+{
+    if (Cpu::all_online())
+        Counter::buddy_lock.inc();
+}
+
+/*
+ * Split a block of the requested order off the freelists (with the lock held)
+ *
+ * @param ord       Block order (2^ord pages)
+ * @param node      Preferred node
+ * @param remote    Fall back to other nodes if the preferred node is exhausted
+ * @return          Pointer to the block or nullptr if unsuccessful
+ */
+Buddy::Block *Buddy::split (order_t ord, Numa::node_t node, bool remote)
+{
+    // Iterate over all nodes, starting with the preferred node
+    for (unsigned n { 0 }; n < (remote ? Numa::nodes : 1); n++) {
+
+        auto &f { freelist[(node + n) % Numa::nodes] };
+
+        // Iterate over all freelists, starting with the requested order
+        for (auto o { ord }; o < orders; o++) {
+
+            // Get the first block from the order(o) freelist
+            auto const block { f.dequeue (o) };
+
+            // If that freelist was empty, try higher orders
+            if (!block)
+                continue;
+
+            // Split higher-order blocks and put the upper half back into the freelist
+            while (o-- != ord) {
+                auto const buddy { block + BIT (o) };
+                assert (buddy->ord == o);
+                f.enqueue (buddy);
+            }
+
+            // Set final block size and mark block as used
+            block->ord = ord;
+            block->tag = Block::Tag::USED;
+
+            // Count remote-node fallback
+            if (n && Cpu::all_online())
+                Counter::buddy_remote.inc();
+
+            return block;
+        }
+    }
+
+    // Out of memory
+    return nullptr;
+}
+
+/*
+ * Refill the per-core block cache from the local freelists and take one block
+ *
+ * @return          Pointer to an order-0 block or nullptr if unsuccessful
+ */
+Buddy::Block *Buddy::refill()
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    count_lock();
+
+    for (Block *b; cachelist.count() < Cachelist::batch && (b = split (0, Numa::node, false)); cachelist.enqueue (b)) ;
+
+    return cachelist.dequeue();
+}
+
 /*
  * Allocate physically and virtually contiguous memory region
  *
  * @param ord       Block order (2^ord pages)
  * @param fill      Fill pattern for the block
+ * @param node      Preferred node (defaults to the node of the current core)
  * @return          Pointer to virtual memory region or nullptr if unsuccessful
  */
-void *Buddy::alloc (order_t ord, Fill fill)
+void *Buddy::alloc (order_t ord, Fill fill, Numa::node_t node)
 {
-    Lock_guard <Spinlock> guard { lock };
+    Block *block { nullptr };
 
-    // Iterate over all freelists, starting with the requested order
-    for (auto o { ord }; o < orders; o++) {
+    // CPU-local memory is only usable once all cores are online
+    auto const online { Cpu::all_online() };
 
-        // Get the first block from the order(o) freelist
-        auto const block { freelist.dequeue (o) };
+    if (node == Numa::local)
+        node = online ? Numa::node : 0;
 
-        // If that freelist was empty, try higher orders
-        if (!block)
-            continue;
+    auto zeroed { false };
 
-        // Split higher-order blocks and put the upper half back into the freelist
-        while (o-- != ord) {
-            auto const buddy { block + BIT (o) };
-            assert (buddy->ord == o);
-            freelist.enqueue (buddy);
-        }
+    // Local order-0 blocks come from the per-core caches, without taking the lock
+    if (!ord && online && node == Numa::node) {
+
+        // Prefer pre-zeroed blocks if zero fill was requested
+        if (fill == Fill::BITS0 && (block = zerolist.dequeue()))
+            zeroed = true;
+
+        else if (EXPECT_TRUE ((block = cachelist.dequeue())))
+            Counter::buddy_hit.inc();
 
-        // Set final block size and mark block as used
-        block->ord = ord;
-        block->tag = Block::Tag::USED;
+        // Fall back to pre-zeroed blocks under memory pressure
+        else if (!(block = refill()))
+            block = zerolist.dequeue();
+    }
+
+    // Other requests and an exhausted local node go to the freelists of all nodes
+    if (!block) {
+
+        Lock_guard <Spinlock> guard { lock };
+
+        count_lock();
 
-        auto const ptr { reinterpret_cast<void *>(index_to_page (block_to_index (block))) };
+        // Under memory pressure, return cached blocks to the freelists, where they may coalesce
+        if (!(block = split (ord, node, true)) && online) {
 
-        // Fill the block if requested
-        if (fill != Fill::NONE)
-            memset (ptr, fill == Fill::BITS0 ? 0 : ~0U, BIT (block->ord + PAGE_BITS));
+            // Ask all cores to flush their caches once they go idle
+            pressure++;
 
-        return ptr;
+            if (flush())
+                block = split (ord, node, true);
+        }
     }
 
     // Out of memory
-    return nullptr;
+    if (EXPECT_FALSE (!block))
+        return nullptr;
+
+    auto const ptr { reinterpret_cast<void *>(index_to_page (block_to_index (block))) };
+
+    // Count synchronous zeroing
+    if (fill == Fill::BITS0 && !zeroed && online)
+        Counter::buddy_zero.inc();
+
+    // Fill the block if requested
+    if (fill != Fill::NONE && !zeroed)
+        memset (ptr, fill == Fill::BITS0 ? 0 : ~0U, BIT (block->ord + PAGE_BITS));
+
+    return ptr;
 }
 
 /*
- * Coalesce to-be-freed block
+ * Zero one block for the per-core pre-zeroed block cache
+ *
+ * @return          True if a block was zeroed, false if there is nothing to do
+ */
+bool Buddy::prezero()
+{
+    if (!Cpu::all_online() || zerolist.count() >= Cachelist::zeros)
+        return false;
+
+    auto block { cachelist.dequeue() };
+
+    if (!block && EXPECT_FALSE (!(block = refill())))
+        return false;
+
+    memset (reinterpret_cast<void *>(index_to_page (block_to_index (block))), 0, PAGE_SIZE (0));
+
+    zerolist.enqueue (block);
+
+    return true;
+}
+
+/*
+ * Return the blocks cached by this core after an allocation failed on any core
+ *
+ * @return          True if the caller should also reclaim memory cached above the allocator, false otherwise
+ */
+bool Buddy::relieve()
+{
+    unsigned const p { pressure };
+
+    if (EXPECT_TRUE (flushed == p && reclaimed == p) || !Cpu::all_online())
+        return false;
+
+    if (flushed != p) {
+
+        Lock_guard <Spinlock> guard { lock };
+
+        count_lock();
+
+        flush();
+    }
+
+    unsigned r { reclaimed };
+
+    // Only the first core to observe the memory pressure reclaims
+    return r != p && reclaimed.compare_exchange_n (r, p);
+}
+
+/*
+ * Coalesce to-be-freed block (with the lock held)
  *
  * @param block     Pointer to the block
  */
 void Buddy::coalesce (Block *block)
 {
-    Lock_guard <Spinlock> guard { lock };
-
     // Ensure block was used
     assert (block->tag == Block::Tag::USED);
 
     // Mark block as free
     block->tag = Block::Tag::FREE;
 
+    auto &f { freelist[block->node] };
+
     // Coalesce adjacent order(o) blocks into an order(o+1) block
     for (auto o { block->ord }; o < orders - 1; block->ord = ++o) {
 
@@ -120,12 +315,12 @@ void Buddy::coalesce (Block *block)
 
         auto const buddy { index_to_block (buddy_idx) };
 
-        // Stop if buddy is not free or fragmented
-        if (buddy->tag != Block::Tag::FREE || buddy->ord != o)
+        // Stop if buddy is not free, fragmented or on another node
+        if (buddy->tag != Block::Tag::FREE || buddy->ord != o || buddy->node != block->node)
             break;
 
         // Dequeue buddy from the freelist
-        freelist.dequeue (buddy);
+        f.dequeue (buddy);
 
         // Merge block with buddy
         if (block > buddy)
@@ -133,7 +328,68 @@ void Buddy::coalesce (Block *block)
     }
 
     // Put final-size block into the freelist
-    freelist.enqueue (block);
+    f.enqueue (block);
+}
+
+/*
+ * Drain a batch of blocks from the per-core block cache into the freelists
+ */
+void Buddy::drain()
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    count_lock();
+
+    for (Block *b; cachelist.count() > Cachelist::limit - Cachelist::batch && (b = cachelist.dequeue()); coalesce (b)) ;
+}
+
+/*
+ * Return all blocks of the per-core block caches to the freelists (with the lock held)
+ *
+ * Pre-zeroed blocks are returned as well, so that they can coalesce.
+ *
+ * @return          True if any blocks were returned, false otherwise
+ */
+bool Buddy::flush()
+{
+    auto const n { cachelist.count() + zerolist.count() };
+
+    for (Block *b; (b = cachelist.dequeue()); coalesce (b)) ;
+    for (Block *b; (b = zerolist.dequeue());  coalesce (b)) ;
+
+    flushed = pressure;
+
+    return n;
+}
+
+/*
+ * Release to-be-freed block
+ *
+ * @param block     Pointer to the block
+ */
+void Buddy::release (Block *block)
+{
+    // CPU-local memory is only usable once all cores are online
+    auto const online { Cpu::all_online() };
+
+    // Local order-0 blocks go into the per-core cache, without taking the lock
+    if (!block->ord && online && block->node == Numa::node) {
+
+        cachelist.enqueue (block);
+
+        if (EXPECT_FALSE (cachelist.count() > Cachelist::limit))
+            drain();
+        else
+            Counter::buddy_hit.inc();
+
+        return;
+    }
+
+    Lock_guard <Spinlock> guard { lock };
+
+    count_lock();
+
+    coalesce (block);
 }
 
 /*
@@ -151,8 +407,8 @@ void Buddy::free (void *ptr)
     // Ensure memory is within allocator range
     assert (valid (idx));
 
-    // Coalesce to-be-freed block
-    coalesce (index_to_block (idx));
+    // Release to-be-freed block
+    release (index_to_block (idx));
 }
 
 /*
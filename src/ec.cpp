@@ -39,6 +39,9 @@
 
 INIT_PRIORITY (PRIO_SLAB) Slab_cache Ec::cache { sizeof (Ec_arch), Kobject::alignment };
 
+INIT_PRIORITY (PRIO_LOCAL) Ec::Claim  Ec::claim;
+INIT_PRIORITY (PRIO_LOCAL) Ec::Claims Ec::claims;
+
 Atomic<Ec *>    Ec::current     { nullptr };
 Ec *            Ec::fpowner     { nullptr };
 unsigned        Ec::donations   { 0 };
@@ -65,7 +68,7 @@ Ec *Ec::create (cpu_t c, cont_t x)
 }
 
 // Factory: HST EC
-Ec *Ec::create_hst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t hva)
+Ec *Ec::create_hst (Status &s, Pd *pd, bool t, bool fpu, Fpu_mode fpm, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t hva)
 {
     // Acquire references
     Refptr<Space_obj> ref_obj { pd->get_obj() };
@@ -79,11 +82,13 @@ Ec *Ec::create_hst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     }
 
     auto const f { fpu ? new (pd->fpu_cache) Fpu : nullptr };
-    auto const u { new Utcb };
+    auto const n { Numa::remote (cpu) };
+    auto const u { new (n) Utcb };
     Ec *ec;
 
     if (EXPECT_TRUE ((!fpu || f) && u && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, ref_pio, cpu, evt, sp, hva, u }))) {
         assert (!ref_obj && !ref_hst && !ref_pio);
+        ec->fpm = fpm;
         return ec;
     }
 
@@ -138,7 +143,7 @@ void Ec::create_root()
     auto info_addr { (Space_hst::selectors() - 1) << PAGE_BITS };
     auto utcb_addr { (Space_hst::selectors() - 2) << PAGE_BITS };
 
-    auto const ec { Pd::create_ec (s, obj, Space_obj::selectors - 4, Pd::root, Cpu::id, 0, 0, utcb_addr, BIT (2) | BIT (1)) };
+    auto const ec { Pd::create_ec (s, obj, Space_obj::selectors - 4, Pd::root, Cpu::id, 0, 0, utcb_addr, BIT (2) | BIT (1), 0) };
     auto const sc { Pd::create_sc (s, obj, Space_obj::selectors - 5, ec, Cpu::id, 1000, Scheduler::priorities - 1, 0) };
 
     if (EXPECT_FALSE (!ec || !sc))
@@ -232,6 +237,12 @@ void Ec::help (Ec *ec, cont_t c)
     if (EXPECT_FALSE (Cpu::hazard & Hazard::SCHED))
         Scheduler::schedule (false);
 
+    // An EC that executes on another CPU cannot be helped, so retry the continuation
+    if (EXPECT_FALSE (ec->xcpu != Cpu::id)) {
+        pause();
+        static_cast<Ec_arch *>(this)->make_current();
+    }
+
     Counter::helping.inc();
 
     ec->activate();
@@ -239,6 +250,134 @@ void Ec::help (Ec *ec, cont_t c)
     Scheduler::schedule (true);
 }
 
+void Ec::Claims::enqueue (Claim *c, cpu_t cpu)
+{
+    auto const r { Kmem::loc_to_glob (cpu, this) };
+
+    bool notify;
+
+    {   Lock_guard <Spinlock> guard { r->lock };
+
+        notify = r->queue.enqueue_tail (c);
+    }
+
+    if (notify)
+        Interrupt::send_cpu (Interrupt::Request::RCL, cpu);
+}
+
+auto Ec::Claims::dequeue()
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    return queue.dequeue_head();
+}
+
+/*
+ * Acquire a handler EC that belongs to another CPU
+ *
+ * The claim is granted by the CPU of the handler EC, which serializes it
+ * against local rendezvous attempts without any atomic operation on the
+ * same-core IPC path. Once granted, the handler executes on this CPU until
+ * it releases itself in reply().
+ *
+ * @param ec    Handler EC
+ * @return      SUCCESS (claim granted), ABORTED (EC busy) or MEM_OBJ (no page table for this CPU)
+ */
+Status Ec::acquire (Ec *ec)
+{
+    // The EC was already claimed by this CPU and is busy
+    if (EXPECT_FALSE (ec->xcpu == Cpu::id))
+        return Status::ABORTED;
+
+    // The EC is busy, so do not bother its CPU with a claim that would be refused
+    if (EXPECT_FALSE (ec->cont || ec->xcpu != ec->cpu))
+        return Status::ABORTED;
+
+    // Ensure the EC can execute on this CPU, which a retry would not change
+    if (EXPECT_FALSE (!static_cast<Ec_arch *>(ec)->prepare_cpu()))
+        return Status::MEM_OBJ;
+
+    auto const c { Kmem::loc_to_glob (Cpu::id, &claim) };
+
+    c->ec    = ec;
+    c->cpu   = Cpu::id;
+    c->grant = false;
+    c->done  = false;
+
+    auto const t { Timer::time() };
+
+    claims.enqueue (c, ec->cpu);
+
+    // Remain responsive to remote claims while waiting
+    Cpu::preemption_enable();
+    while (!c->done.load (__ATOMIC_ACQUIRE))
+        pause();
+    Cpu::preemption_disable();
+
+    if (!c->grant)
+        return Status::ABORTED;
+
+    // Start of the round trip, which ends in release()
+    ec->xtime = t;
+
+    return Status::SUCCESS;
+}
+
+/*
+ * Grant or refuse all pending claims for handler ECs of this CPU
+ */
+void Ec::handle_claims()
+{
+    for (Claim *c; (c = claims.dequeue()); c->done.store (true, __ATOMIC_RELEASE)) {
+
+        auto const ec { c->ec };
+
+        // Refuse the claim if the EC is busy
+        if (!(c->grant = !ec->cont))
+            continue;
+
+        // Save FPU state of the EC that is live on this CPU
+        if (fpowner == ec)
+            switch_fpu (nullptr);
+
+        ec->xcpu = c->cpu;
+        ec->cont = claimed;
+    }
+}
+
+/*
+ * Release a handler EC that executed on behalf of a cross-core claim
+ *
+ * @param c     Continuation for the EC
+ */
+void Ec::release (cont_t c)
+{
+    auto const ec { caller };
+
+    // Save FPU state of this EC that is live on this CPU
+    if (fpowner == this)
+        switch_fpu (nullptr);
+
+    auto const donated { ec && ec->clr_partner() };
+
+    // Account the round trip of the cross-core call
+    Counter::xcall.inc();
+    Counter::xcall_time.add (Timer::time() - xtime);
+
+    xcpu = cpu;
+
+    // Ordering: RELEASE to publish the state of this EC before its CPU can reclaim it
+    cont.store (c, __ATOMIC_RELEASE);
+
+    if (EXPECT_TRUE (donated))
+        static_cast<Ec_arch *>(ec)->make_current();
+
+    if (EXPECT_TRUE (ec))
+        Scheduler::get_current()->get_ec()->activate();
+
+    Scheduler::schedule (true);
+}
+
 void Ec::idle (Ec *const self)
 {
     trace (TRACE_CONT, "%s", __func__);
@@ -249,6 +388,16 @@ void Ec::idle (Ec *const self)
         if (EXPECT_FALSE (hzd))
             self->handle_hazard (hzd, idle);
 
+        // Return cached memory after an allocation failed on any core
+        if (EXPECT_FALSE (Buddy::relieve()))
+            Slab_cache::reclaim();
+
+        // Zero pages for the allocator while there is nothing else to do
+        if (Buddy::prezero()) {
+            Cpu::preemption_point();
+            continue;
+        }
+
         Cpu::halt();
     }
 }
@@ -269,9 +418,10 @@ void Ec::kill (char const *reason)
  * Switch FPU ownership
  *
  * @param ec    Prospective new owner (or nullptr to unassign FPU)
+ * @param pre   Switch ahead of the first FPU use (true) or on FPU use (false)
  * @return      True if FPU ownership was changed, false otherwise
  */
-bool Ec::switch_fpu (Ec *ec)
+bool Ec::switch_fpu (Ec *ec, bool pre)
 {
     // We want to assign the FPU to an EC
     if (EXPECT_TRUE (ec)) {
@@ -279,15 +429,20 @@ bool Ec::switch_fpu (Ec *ec)
         // The EC must not be the FPU owner
         assert (fpowner != ec);
 
-        // The FPU must be disabled
-        assert (!(Cpu::hazard & Hazard::FPU));
-
         // The EC is not eligible to use the FPU
         if (EXPECT_FALSE (!ec->fpu))
             return false;
+
+        // Only count actual FPU use, which turns ADAPTIVE eager after fpu_eager runs
+        if (!pre)
+            ec->fpu_use = ec->fpu_use < fpu_eager - 1 ? static_cast<uint8_t>(ec->fpu_use + 1) : fpu_hold;
+
+        ec->fpu_pre = pre;
     }
 
-    Fpu::enable();
+    // The FPU is disabled on #NM, but may still be enabled for an eager switch
+    if (!(Cpu::hazard & Hazard::FPU))
+        Fpu::enable();
 
     // Save state of previous owner
     if (EXPECT_TRUE (fpowner))
@@ -301,3 +456,41 @@ bool Ec::switch_fpu (Ec *ec)
 
     return true;
 }
+
+/*
+ * Switch FPU ownership ahead of the first FPU use, according to the FPU policy
+ *
+ * @param ec    EC that ran before this EC
+ */
+void Ec::fpu_prefetch (Ec *ec)
+{
+    if (ec) {
+
+        // The previous EC did not use the FPU during its last run
+        if (fpowner != ec)
+            ec->fpu_use = 0;
+
+        // The FPU of the previous EC was switched eagerly, so its use is unknown
+        else if (ec->fpu_pre) {
+            ec->fpu_pre = false;
+            if (ec->fpu_use)
+                ec->fpu_use--;
+        }
+    }
+
+    if (fpowner == this || !fpu)
+        return;
+
+    switch (fpm) {
+        case Fpu_mode::LAZY:
+            return;
+        case Fpu_mode::ADAPTIVE:
+            if (fpu_use < fpu_eager)
+                return;
+            break;
+        case Fpu_mode::EAGER:
+            break;
+    }
+
+    switch_fpu (this, true);
+}
@@ -0,0 +1,88 @@
+/*
+ * Non-Uniform Memory Access (NUMA)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "cpu.hpp"
+#include "kmem.hpp"
+#include "numa.hpp"
+#include "stdio.hpp"
+
+Numa::node_t Numa::node;
+
+/*
+ * Map a proximity domain to a node
+ *
+ * @param pxd   Proximity domain
+ * @return      Node for the proximity domain (node 0 if there are too many)
+ */
+Numa::node_t Numa::lookup (uint32_t pxd)
+{
+    for (node_t n { 0 }; n < count; n++)
+        if (domain[n] == pxd)
+            return n;
+
+    if (EXPECT_FALSE (count == nodes)) {
+        trace (TRACE_FIRM, "NUMA: Domain %u exceeds %u nodes", pxd, nodes);
+        return 0;
+    }
+
+    domain[count] = pxd;
+
+    return count++;
+}
+
+/*
+ * Determine the node of a core
+ *
+ * @param cpu   Core
+ * @return      Node of the core (node 0 while cores are still coming online)
+ */
+Numa::node_t Numa::remote (cpu_t cpu)
+{
+    return Cpu::all_online() ? *Kmem::loc_to_glob (cpu, &node) : 0;
+}
+
+/*
+ * Determine the node of a physical memory address
+ *
+ * @param phys  Physical address
+ * @return      Node of the memory (node 0 if not described)
+ */
+Numa::node_t Numa::memory (uint64_t phys)
+{
+    for (unsigned i { 0 }; i < ranges; i++)
+        if (phys - range[i].base < range[i].size)
+            return range[i].node;
+
+    return 0;
+}
+
+/*
+ * Add a memory range with its proximity domain
+ *
+ * @param base  Physical base address of the range
+ * @param size  Size of the range
+ * @param pxd   Proximity domain of the range
+ */
+void Numa::add_memory (uint64_t base, uint64_t size, uint32_t pxd)
+{
+    if (EXPECT_FALSE (ranges == max_ranges)) {
+        trace (TRACE_FIRM, "NUMA: Range %#lx-%#lx exceeds %u ranges", base, base + size, max_ranges);
+        return;
+    }
+
+    range[ranges++] = { base, size, lookup (pxd) };
+}
@@ -175,9 +175,17 @@ Pd *Pd::create_pd (Status &s, Space_obj *obj, unsigned long sel, unsigned prm)
     return nullptr;
 }
 
-Ec *Pd::create_ec (Status &s, Space_obj *obj, unsigned long sel, Pd *pd, cpu_t cpu, uintptr_t evt, uintptr_t sp, uintptr_t hva, uint8_t flg)
+Ec *Pd::create_ec (Status &s, Space_obj *obj, unsigned long sel, Pd *pd, cpu_t cpu, uintptr_t evt, uintptr_t sp, uintptr_t hva, uint8_t flg, uint8_t ftr)
 {
-    auto const o { (flg & BIT (0) ? Ec::create_gst : Ec::create_hst) (s, pd, flg & BIT (1), flg & BIT (2), cpu, evt, sp, hva) };
+    auto const fpm { Ec::Fpu_mode (ftr >> 2 & BIT_RANGE (1, 0)) };
+
+    if (EXPECT_FALSE (fpm > Ec::Fpu_mode::ADAPTIVE)) {
+        s = Status::BAD_PAR;
+        return nullptr;
+    }
+
+    auto const o { flg & BIT (0) ? Ec::create_gst (s, pd, flg & BIT (1), flg & BIT (2), fpm, flg & BIT (3), ftr & BIT (0), ftr & BIT (1), cpu, evt, sp, hva)
+                                 : Ec::create_hst (s, pd, flg & BIT (1), flg & BIT (2), fpm, cpu, evt, sp, hva) };
 
     if (EXPECT_TRUE (o)) {
 
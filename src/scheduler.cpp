@@ -39,10 +39,11 @@ void Scheduler::Ready::enqueue (Sc *sc, uint64_t t)
     assert (sc->cpu == Cpu::id);
     assert (sc->prio < priorities);
 
-    if (sc->prio > prio_top)
-        prio_top = sc->prio;
-
-    queue[sc->prio].enqueue (sc, sc->left);
+    // Mark the priority level as non-empty
+    if (queue[sc->prio].enqueue (sc, sc->left)) {
+        prio_map[sc->prio / bpw] |= BITN (sc->prio % bpw);
+        prio_sum |= BITN (sc->prio / bpw);
+    }
 
     if (sc->prio > current->prio || (sc != current && sc->prio == current->prio && sc->left))
         Cpu::hazard |= Hazard::SCHED;
@@ -55,14 +56,18 @@ void Scheduler::Ready::enqueue (Sc *sc, uint64_t t)
 
 auto Scheduler::Ready::dequeue (uint64_t t)
 {
-    auto const sc { queue[prio_top].dequeue_head() };
+    assert (prio_sum);
+
+    auto const prio { prio_top() };
+    auto const sc { queue[prio].dequeue_head() };
 
     assert (sc);
     assert (sc->cpu == Cpu::id);
-    assert (sc->prio < priorities);
+    assert (sc->prio == prio);
 
-    while (queue[prio_top].empty() && prio_top)
-        prio_top--;
+    // Mark the priority level as empty
+    if (queue[prio].empty() && !(prio_map[prio / bpw] &= ~BITN (prio % bpw)))
+        prio_sum &= ~BITN (prio / bpw);
 
     if (EXPECT_TRUE (sc->ec != current->ec))
         sc->ec->adjust_offset_ticks (t - sc->last);
@@ -22,9 +22,11 @@
 #include "assert.hpp"
 #include "bits.hpp"
 #include "buddy.hpp"
+#include "cpu.hpp"
 #include "lock_guard.hpp"
 #include "slab.hpp"
 #include "std.hpp"
+#include "stdio.hpp"
 
 struct Slab_cache::Slab
 {
@@ -131,11 +133,35 @@ struct Slab_cache::Slab
     }
 };
 
+struct Slab_cache::Magazine
+{
+    static constexpr unsigned size { 14 };
+
+    Magazine *  next    { nullptr };            // Depot Linkage
+    unsigned    rounds  { 0 };                  // Number of Rounds
+    void *      round[size];                    // Rounds (Buffers)
+
+    bool full() const   { return rounds == size; }
+    bool empty() const  { return !rounds; }
+
+    ALWAYS_INLINE
+    inline void push (void *p) { round[rounds++] = p; }
+
+    [[nodiscard]] ALWAYS_INLINE
+    inline void *pop() { return round[--rounds]; }
+};
+
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Slab_cache::magazines { sizeof (Magazine), alignof (Magazine), 1, false };
+
+alignas (Slab_cache) static constinit uint8_t locals_storage[sizeof (Slab_cache)];
+
 /*
  * Slab Cache Constructor
  *
  * @param s Required element size
  * @param a Required element alignment (must be a power of 2)
+ * @param k Number of empty slabs to retain
+ * @param m Enable the per-core magazine layer
  *
  * Slab Linkage Example (P:partial precede F:full)
  *
@@ -147,9 +173,91 @@ struct Slab_cache::Slab
  *  head &&  curr => slab cache contains some P-Slabs => buffer in curr available
  * !head && !curr => slab cache contains no slabs => initial state
  * !head &&  curr => illegal
+ *
+ * Up to k empty slabs are retained among the P-Slabs.
+ */
+Slab_cache::Slab_cache (size_t s, size_t a, unsigned k, bool m) : bsz (static_cast<uint16_t>(align_up (max (s, sizeof (Slab::Buffer)), max (a, alignof (Slab::Buffer))))),
+                                                                  bps ((PAGE_SIZE (0) - sizeof (Slab::Metadata)) / bsz),
+                                                                  keep (static_cast<uint16_t>(k)),
+                                                                  mag { m }
+{
+    Lock_guard <Spinlock> guard { list_lock };
+
+    // Register slab cache for reclaim
+    if ((next = list))
+        next->prev = this;
+
+    list = this;
+}
+
+/*
+ * Get the slab cache for per-core magazine arrays
+ *
+ * The arrays are sized by the number of cores, which is unknown during
+ * static construction, so the slab cache is constructed on first use.
+ * If fewer than two arrays fit into a slab, each array gets its own
+ * buddy block instead.
+ *
+ * @return  Pointer to the slab cache or nullptr if arrays come from the buddy allocator
+ */
+Slab_cache *Slab_cache::arrays()
+{
+    auto const size { Cpu::count * sizeof (Local) };
+
+    if (size > (PAGE_SIZE (0) - sizeof (Slab::Metadata)) / 2)
+        return nullptr;
+
+    auto c { locals.load (__ATOMIC_ACQUIRE) };
+
+    if (EXPECT_FALSE (!c)) {
+
+        Lock_guard <Spinlock> guard { locals_lock };
+
+        if (!(c = locals)) {
+            c = new (locals_storage) Slab_cache { size, alignof (Local), 1, false };
+            locals.store (c, __ATOMIC_RELEASE);
+        }
+    }
+
+    return c;
+}
+
+/*
+ * Get the magazines of the current core
+ *
+ * @return  Pointer to the per-core magazines (success) or nullptr (failure)
  */
-Slab_cache::Slab_cache (size_t s, size_t a) : bsz (static_cast<uint16_t>(align_up (max (s, sizeof (Slab::Buffer)), max (a, alignof (Slab::Buffer))))),
-                                              bps ((PAGE_SIZE (0) - sizeof (Slab::Metadata)) / bsz) {}
+Slab_cache::Local *Slab_cache::magazine()
+{
+    // CPU-local memory is only mapped on all cores once all cores are online
+    if (EXPECT_FALSE (!mag || !Cpu::all_online()))
+        return nullptr;
+
+    auto l { local.load (__ATOMIC_ACQUIRE) };
+
+    // Allocate the per-core magazine array on first use
+    if (EXPECT_FALSE (!l)) {
+
+        Lock_guard <Spinlock> guard { lock };
+
+        if (!(l = local)) {
+
+            auto const a    { arrays() };
+            auto const size { Cpu::count * sizeof (Local) };
+            auto const ord  { size > PAGE_SIZE (0) ? bit_scan_msb (size - 1) + 1 - PAGE_BITS : 0 };
+
+            if (EXPECT_FALSE (!(l = static_cast<Local *>(a ? a->alloc() : Buddy::alloc (static_cast<uint8_t>(ord))))))
+                return nullptr;
+
+            for (cpu_t c { 0 }; c < Cpu::count; c++)
+                new (l + c) Local;
+
+            local.store (l, __ATOMIC_RELEASE);
+        }
+    }
+
+    return l + Cpu::id;
+}
 
 /*
  * Allocate an element in this slab cache
@@ -158,8 +266,304 @@ Slab_cache::Slab_cache (size_t s, size_t a) : bsz (static_cast<uint16_t>(align_u
  */
 void *Slab_cache::alloc()
 {
+    auto const l { magazine() };
+
+    if (EXPECT_TRUE (l)) {
+
+        l->allocs++;
+
+        // Allocate from the loaded magazine
+        if (EXPECT_TRUE (l->loaded && !l->loaded->empty()))
+            return l->loaded->pop();
+
+        // Exchange loaded and previous magazine and allocate from the latter
+        if (l->previous && !l->previous->empty()) {
+            auto const m { l->previous };
+            l->previous = l->loaded;
+            l->loaded = m;
+            return m->pop();
+        }
+    }
+
+    auto p { alloc_locked (l) };
+
+    // Out of memory: Reclaim cached memory from all slab caches and retry
+    if (EXPECT_FALSE (!p) && mag && reclaim())
+        p = alloc_locked (l);
+
+    return p;
+}
+
+/*
+ * Allocate an element in this slab cache from the depot or the slab layer
+ *
+ * @param l Pointer to the per-core magazines (or nullptr)
+ * @return  Pointer to the element (success) or nullptr (failure)
+ */
+void *Slab_cache::alloc_locked (Local *l)
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    if (!l)
+        allocs++;
+
+    // Both magazines are empty: Return the previous magazine to the depot and load a full magazine from the depot
+    else if (full) {
+
+        if (l->previous) {
+            l->previous->next = empty;
+            empty = l->previous;
+        }
+
+        l->previous = l->loaded;
+        l->loaded = full;
+        full = full->next;
+
+        return l->loaded->pop();
+    }
+
+    return alloc_buffer();
+}
+
+/*
+ * Free an element in this slab cache
+ *
+ * @param p Pointer to the element
+ */
+void Slab_cache::free (void *p)
+{
+    auto const l { magazine() };
+
+    if (EXPECT_TRUE (l)) {
+
+        l->frees++;
+
+        // Free into the loaded magazine
+        if (EXPECT_TRUE (l->loaded && !l->loaded->full())) {
+            l->loaded->push (p);
+            return;
+        }
+
+        // Exchange loaded and previous magazine and free into the latter
+        if (l->previous && !l->previous->full()) {
+            auto const m { l->previous };
+            l->previous = l->loaded;
+            l->loaded = m;
+            m->push (p);
+            return;
+        }
+    }
+
+    Lock_guard <Spinlock> guard { lock };
+
+    if (!l)
+        frees++;
+
+    // Both magazines are full: Return the previous magazine to the depot and load an empty magazine
+    else {
+
+        auto m { empty };
+
+        if (m)
+            empty = m->next;
+        else if (auto const b { magazines.alloc() }; b)
+            m = new (b) Magazine;
+
+        if (EXPECT_TRUE (m)) {
+
+            if (l->previous) {
+                l->previous->next = full;
+                full = l->previous;
+            }
+
+            l->previous = l->loaded;
+            l->loaded = m;
+
+            m->push (p);
+            return;
+        }
+    }
+
+    free_buffer (p);
+}
+
+/*
+ * Return all magazines and empty slabs of this slab cache
+ *
+ * This must only be called when no core uses the slab cache anymore.
+ */
+void Slab_cache::flush()
+{
+    {   Lock_guard <Spinlock> guard { list_lock };
+
+        // Unregister slab cache
+        if (next)
+            next->prev = prev;
+        if (prev)
+            prev->next = next;
+        else if (list == this)
+            list = next;
+
+        prev = next = nullptr;
+    }
+
+    Lock_guard <Spinlock> guard { lock };
+
+    auto const l { local.load() };
+
+    if (l) {
+
+        // Move all per-core magazines into the depot
+        for (cpu_t c { 0 }; c < Cpu::count; c++) {
+
+            Magazine *const mags[] { l[c].loaded, l[c].previous };
+
+            for (auto m : mags) {
+
+                if (!m)
+                    continue;
+
+                m->next = full;
+                full = m;
+            }
+        }
+
+        local = nullptr;
+
+        if (auto const a { arrays() }; a)
+            a->free (l);
+        else
+            Buddy::free (l);
+    }
+
+    drain();
+
+    trim();
+}
+
+/*
+ * Return all magazines in the depot to the slab layer (with the lock held)
+ */
+void Slab_cache::drain()
+{
+    Magazine **const depot[] { &full, &empty };
+
+    // Free all rounds and all magazines
+    for (auto d : depot) {
+
+        for (Magazine *m; (m = *d); magazines.free (m)) {
+
+            *d = m->next;
+
+            while (!m->empty())
+                free_buffer (m->pop());
+        }
+    }
+}
+
+/*
+ * Deallocate all retained empty slabs (with the lock held)
+ *
+ * @return  Number of deallocated slabs
+ */
+size_t Slab_cache::trim()
+{
+    size_t n { 0 };
+
+    // Empty slabs are among the partial slabs, which precede the full slabs
+    for (Slab *s { head }, *x; s && !s->meta.full(); s = x) {
+
+        x = s->meta.next;
+
+        if (!s->meta.empty())
+            continue;
+
+        unlink (s);
+
+        delete s;
+
+        n++;
+    }
+
+    nempty = 0;
+
+    return n;
+}
+
+/*
+ * Reclaim memory cached in all slab caches
+ *
+ * This must not be called with any slab cache lock held.
+ *
+ * @return  Number of deallocated slabs
+ */
+size_t Slab_cache::reclaim()
+{
+    size_t n { 0 };
+
+    Lock_guard <Spinlock> guard { list_lock };
+
+    for (auto c { list }; c; c = c->next) {
+
+        size_t t;
+
+        {   Lock_guard <Spinlock> guard_cache { c->lock };
+
+            c->drain();
+
+            n += t = c->trim();
+        }
+
+        if (t) {
+            auto const s { c->stats() };
+            trace (TRACE_MEMORY, "SLAB: %p reclaimed %lu slabs (P:%u F:%u E:%u A:%lu F:%lu)", static_cast<void *>(c), t, s.partial, s.full, s.empty, s.allocs, s.frees);
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Get statistics for this slab cache
+ *
+ * Request rates can be derived by sampling the request counts.
+ *
+ * @return  Slab and request statistics
+ */
+Slab_cache::Stats Slab_cache::stats()
+{
+    Stats s;
+
     Lock_guard <Spinlock> guard { lock };
 
+    for (auto slab { head }; slab; slab = slab->meta.next, s.slabs++)
+        if (slab->meta.full())
+            s.full++;
+        else if (slab->meta.empty())
+            s.empty++;
+        else
+            s.partial++;
+
+    s.allocs = allocs;
+    s.frees  = frees;
+
+    if (auto const l { local.load() }; l) {
+        for (cpu_t c { 0 }; c < Cpu::count; c++) {
+            s.allocs += l[c].allocs;
+            s.frees  += l[c].frees;
+        }
+    }
+
+    return s;
+}
+
+/*
+ * Allocate a buffer in the slab layer (with the lock held)
+ *
+ * @return  Pointer to the buffer (success) or nullptr (failure)
+ */
+void *Slab_cache::alloc_buffer()
+{
     // Cache contains no slabs or only full slabs
     if (EXPECT_FALSE (!curr)) {
 
@@ -177,6 +581,8 @@ void *Slab_cache::alloc()
             head->meta.prev = slab;
 
         head = curr = slab;
+
+        nempty++;
     }
 
     // The current slab must be either empty or partial
@@ -185,6 +591,10 @@ void *Slab_cache::alloc()
     // If we have a successor slab, it must be full
     assert (!curr->meta.next || curr->meta.next->meta.full());
 
+    // Slab Transition Empty => Partial/Full
+    if (EXPECT_FALSE (curr->meta.empty()))
+        nempty--;
+
     // Allocate element in current slab
     auto const p { curr->meta.alloc() };
 
@@ -196,14 +606,36 @@ void *Slab_cache::alloc()
 }
 
 /*
- * Free an element in this slab cache
+ * Unlink a slab from this slab cache (with the lock held)
  *
- * @param p Pointer to the element
+ * @param slab  Pointer to the slab
  */
-void Slab_cache::free (void *p)
+void Slab_cache::unlink (Slab *slab)
 {
-    Lock_guard <Spinlock> guard { lock };
+    // If the slab was curr, new curr is the slab's predecessor
+    if (slab == curr)
+        curr = slab->meta.prev;
 
+    // If the slab was head, new head is the slab's successor
+    if (slab == head)
+        head = slab->meta.next;
+
+    // Unlink slab
+    if (slab->meta.prev)
+        slab->meta.prev->meta.next = slab->meta.next;
+    if (slab->meta.next)
+        slab->meta.next->meta.prev = slab->meta.prev;
+
+    slab->meta.prev = slab->meta.next = nullptr;
+}
+
+/*
+ * Free a buffer in the slab layer (with the lock held)
+ *
+ * @param p Pointer to the buffer
+ */
+void Slab_cache::free_buffer (void *p)
+{
     // Compute slab for this element
     auto const slab { Slab::from_buffer (p) };
 
@@ -216,25 +648,18 @@ void Slab_cache::free (void *p)
     // Slab Transition Full/Partial => Empty
     if (EXPECT_FALSE (slab->meta.empty())) {
 
-        // If the slab was curr, new curr is the slab's predecessor
-        if (slab == curr)
-            curr = slab->meta.prev;
-
-        // If the slab was head, new head is the slab's successor
-        if (slab == head)
-            head = slab->meta.next;
-
-        // Unlink slab
-        if (slab->meta.prev)
-            slab->meta.prev->meta.next = slab->meta.next;
-        if (slab->meta.next)
-            slab->meta.next->meta.prev = slab->meta.prev;
+        // Deallocate slab if enough empty slabs are retained already
+        if (nempty >= keep) {
+            unlink (slab);
+            delete slab;
+            return;
+        }
 
-        // Deallocate slab
-        delete slab;
+        nempty++;
+    }
 
-    // Slab Transition Full => Partial
-    } else if (EXPECT_FALSE (was_full)) {
+    // Slab Transition Full => Partial/Empty
+    if (EXPECT_FALSE (was_full)) {
 
         // Slab is now partial and there are full slabs in front it => requeue
         if (slab->meta.prev && slab->meta.prev->meta.full()) {
@@ -60,7 +60,7 @@ template<typename T> Status Space_mem<T>::delegate (Space_hst const *hst, unsign
             break;
     }
 
-    static_cast<T *>(this)->sync();
+    static_cast<T *>(this)->sync (dsb << PAGE_BITS, ord);
 
     Buddy::free_wait();
 
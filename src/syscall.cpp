@@ -98,10 +98,15 @@ void Ec::recv_user (Ec *const self)
     Ec_arch::ret_user_hypercall (self);
 }
 
-void Ec::rendezvous (Ec *const ec, cont_t c, cont_t e, uintptr_t ip, uintptr_t id, uintptr_t mtd)
+Status Ec::rendezvous (Ec *const ec, cont_t c, cont_t e, uintptr_t ip, uintptr_t id, uintptr_t mtd)
 {
-    if (EXPECT_FALSE (ec->cont))
-        return;
+    if (EXPECT_FALSE (ec->cpu != Cpu::id)) {
+        if (auto const s { acquire (ec) }; s != Status::SUCCESS)
+            return s;
+    }
+
+    else if (EXPECT_FALSE (ec->cont))
+        return Status::ABORTED;
 
     cont = c;
     set_partner (ec);
@@ -118,6 +123,9 @@ void Ec::rendezvous (Ec *const ec, cont_t c, cont_t e, uintptr_t ip, uintptr_t i
 
 void Ec::reply (cont_t c)
 {
+    if (EXPECT_FALSE (cpu != Cpu::id))
+        release (c);
+
     cont = c;
 
     auto const ec { caller };
@@ -148,12 +156,10 @@ template<Ec::cont_t C> void Ec::send_msg (Ec *const self)
     auto const pt { static_cast<Pt *>(cpt.obj()) };
     auto const ec { pt->get_ec() };
 
-    if (EXPECT_FALSE (self->cpu != ec->cpu))
-        self->kill ("PT wrong CPU");
-
     assert (ec->subtype == Kobject::Subtype::EC_LOCAL);
 
-    self->rendezvous (ec, C, recv_kern, pt->get_ip(), pt->get_id(), pt->get_mtd());
+    if (EXPECT_FALSE (self->rendezvous (ec, C, recv_kern, pt->get_ip(), pt->get_id(), pt->get_mtd()) == Status::MEM_OBJ))
+        self->kill ("PT EC not executable");
 
     self->help (ec, send_msg<C>);
 
@@ -173,12 +179,10 @@ void Ec::sys_ipc_call (Ec *const self)
     auto const pt { static_cast<Pt *>(cpt.obj()) };
     auto const ec { pt->get_ec() };
 
-    if (EXPECT_FALSE (self->cpu != ec->cpu))
-        sys_finish<Status::BAD_CPU> (self);
-
     assert (ec->subtype == Kobject::Subtype::EC_LOCAL);
 
-    self->rendezvous (ec, Ec_arch::ret_user_hypercall, recv_user, pt->get_ip(), pt->get_id(), r.mtd());
+    if (EXPECT_FALSE (self->rendezvous (ec, Ec_arch::ret_user_hypercall, recv_user, pt->get_ip(), pt->get_id(), r.mtd()) == Status::MEM_OBJ))
+        sys_finish<Status::MEM_OBJ> (self);
 
     if (EXPECT_FALSE (r.timeout()))
         sys_finish<Status::TIMEOUT> (self);
@@ -242,7 +246,7 @@ void Ec::sys_create_ec (Ec *const self)
 {
     Sys_create_ec r { self->sys_regs() };
 
-    trace (TRACE_SYSCALL, "EC:%p %s SEL:%#lx PD:%#lx CPU:%#x HVA:%#lx SP:%#lx EVT:%#lx", static_cast<void *>(self), __func__, r.sel(), r.pd(), r.cpu(), r.hva(), r.sp(), r.evt());
+    trace (TRACE_SYSCALL, "EC:%p %s SEL:%#lx PD:%#lx CPU:%#x HVA:%#lx SP:%#lx EVT:%#lx FTR:%#x", static_cast<void *>(self), __func__, r.sel(), r.pd(), r.cpu(), r.hva(), r.sp(), r.evt(), r.ftr());
 
     if (EXPECT_FALSE (r.hva() >= Space_hst::selectors() << PAGE_BITS))
         self->sys_finish_status (Status::BAD_PAR);
@@ -257,7 +261,7 @@ void Ec::sys_create_ec (Ec *const self)
         self->sys_finish_status (Status::BAD_CAP);
 
     Status s;
-    Pd::create_ec (s, obj, r.sel(), static_cast<Pd *>(cpd.obj()), r.cpu(), r.evt(), r.sp(), r.hva(), r.flg());
+    Pd::create_ec (s, obj, r.sel(), static_cast<Pd *>(cpd.obj()), r.cpu(), r.evt(), r.sp(), r.hva(), r.flg(), r.ftr());
 
     self->sys_finish_status (s);
 }
@@ -377,7 +381,7 @@ void Ec::sys_ctrl_ec (Ec *const self)
 {
     Sys_ctrl_ec r { self->sys_regs() };
 
-    trace (TRACE_SYSCALL, "EC:%p %s EC:%#lx (%c)", static_cast<void *>(self), __func__, r.ec(), r.strong() ? 'S' : 'W');
+    trace (TRACE_SYSCALL, "EC:%p %s EC:%#lx (%c%c)", static_cast<void *>(self), __func__, r.ec(), r.strong() ? 'S' : 'W', r.vint() ? 'V' : '-');
 
     auto const obj { self->regs.get_obj() };
     auto const cec { obj->lookup (r.ec()) };
@@ -387,24 +391,34 @@ void Ec::sys_ctrl_ec (Ec *const self)
 
     auto const ec { static_cast<Ec *>(cec.obj()) };
 
+    // Virtual interrupt: Injected on the next guest entry without a VMM round trip
+    if (r.vint())
+        self->sys_finish_status (static_cast<Ec_arch *>(ec)->post_vint (r.vid(), r.vpr()));
+
+    // A claimed handler EC executes on the claiming CPU
+    cpu_t const c { ec->xcpu };
+
     // Strong: Must wait for observation even if the hazard was set already
     if (r.strong()) {
 
         ec->regs.hazard.set (Hazard::RECALL);
 
         // Send IPI only if the EC is remote and current on its core
-        if (Cpu::id != ec->cpu && Ec::remote_current (ec->cpu) == ec) {
+        if (Cpu::id != c && Ec::remote_current (c) == ec) {
             Cpu::preemption_enable();
-            auto cnt { Counter::req[Interrupt::Request::RKE].get (ec->cpu) };
-            Interrupt::send_cpu (Interrupt::Request::RKE, ec->cpu);
-            while (Counter::req[Interrupt::Request::RKE].get (ec->cpu) == cnt)
+            auto cnt { Counter::req[Interrupt::Request::RKE].get (c) };
+            Interrupt::send_cpu (Interrupt::Request::RKE, c);
+            while (Counter::req[Interrupt::Request::RKE].get (c) == cnt)
                 pause();
             Cpu::preemption_disable();
         }
 
     // Weak: Send IPI only if the hazard was not set already and the EC is remote and current on its core
-    } else if (!ec->regs.hazard.tas (Hazard::RECALL) && Cpu::id != ec->cpu && Ec::remote_current (ec->cpu) == ec)
-        Interrupt::send_cpu (Interrupt::Request::RKE, ec->cpu);
+    } else if (!ec->regs.hazard.tas (Hazard::RECALL) && Cpu::id != c && Ec::remote_current (c) == ec)
+        Interrupt::send_cpu (Interrupt::Request::RKE, c);
+
+    // A vCPU blocked in WFI observes the recall once it runs again
+    static_cast<Ec_arch *>(ec)->wake_wfi();
 
     self->sys_finish_status (Status::SUCCESS);
 }
@@ -20,83 +20,174 @@
 #include "timeout.hpp"
 #include "timer.hpp"
 
-void Timeout::enqueue (uint64_t t)
+/*
+ * Link two heaps
+ *
+ * @param a     Root of the first heap
+ * @param b     Root of the second heap
+ * @return      Root of the linked heap
+ */
+Timeout *Timeout::meld (Timeout *a, Timeout *b)
 {
-    assert (this != list);
-    assert (!prev);
-    assert (!next);
+    assert (!a->prev && !a->next);
+    assert (!b->prev && !b->next);
 
-    time = t;
+    if (b->time < a->time) {
+        auto const t { a }; a = b; b = t;
+    }
+
+    // Make b the first child of a
+    if ((b->next = a->child))
+        b->next->prev = b;
+
+    b->prev = a;
+    a->child = b;
+
+    return a;
+}
+
+/*
+ * Combine a list of sibling heaps into one heap using the two-pass method
+ *
+ * @param n     First heap in the sibling list
+ * @return      Root of the combined heap
+ */
+Timeout *Timeout::combine (Timeout *n)
+{
+    Timeout *r { nullptr };
+
+    // Pass 1: Link pairs from left to right, stacking the results in r
+    while (n) {
+
+        auto a { n };
+        auto const b { n->next };
 
-    Timeout *p { nullptr };
+        n = b ? b->next : nullptr;
 
-    for (auto n { list }; n; p = n, n = n->next)
-        if (n->time >= time)
-            break;
+        a->prev = a->next = nullptr;
 
-    prev = p;
+        if (b) {
+            b->prev = b->next = nullptr;
+            a = meld (a, b);
+        }
 
-    if (!p) {
-        next = list;
-        list = this;
-        sync();
-    } else {
-        next = p->next;
-        p->next = this;
+        a->next = r;
+        r = a;
     }
 
-    if (next)
-        next->prev = this;
+    Timeout *h { nullptr };
+
+    // Pass 2: Link the stacked heaps from right to left
+    while (r) {
+
+        auto const a { r };
+
+        r = r->next;
+        a->next = nullptr;
+
+        h = h ? meld (h, a) : a;
+    }
+
+    return h;
 }
 
-uint64_t Timeout::dequeue()
+void Timeout::remove()
 {
-    if (list == this || prev) {
+    assert (queued());
 
-        if (next)
-            next->prev = prev;
+    if (this == heap)
+        heap = combine (child);
+
+    else {
 
-        if (prev)
+        // Cut this subtree from its parent or left sibling
+        if (prev->child == this)
+            prev->child = next;
+        else
             prev->next = next;
 
-        else {
-            list = next;
-            sync();
-        }
+        if (next)
+            next->prev = prev;
 
         prev = next = nullptr;
+
+        if (child)
+            heap = meld (heap, combine (child));
     }
 
-    assert (this != list);
+    child = nullptr;
+
+    assert (this != heap);
     assert (!prev);
     assert (!next);
+}
+
+void Timeout::enqueue (uint64_t t)
+{
+    assert (!queued());
+    assert (!child);
+
+    time = t;
+
+    heap = heap ? meld (heap, this) : this;
+
+    update();
+}
+
+uint64_t Timeout::dequeue()
+{
+    if (queued()) {
+        remove();
+        update();
+    }
+
+    assert (!queued());
 
     return time;
 }
 
 void Timeout::check()
 {
-    while (list && list->time <= Timer::time()) {
-        Timeout *t = list;
-        t->dequeue();
+    while (heap && heap->time <= Timer::time()) {
+        Timeout *t = heap;
+        t->remove();
         t->trigger();
     }
+
+    // The expired deadline has disarmed the timer
+    sync();
 }
 
-void Timeout::sync()
+void Timeout::program (uint64_t d)
 {
-    if (list)
-        Timer::set_dln (list->time);
+    if (d != none)
+        Timer::set_dln (d);
     else
         Timer::stop();
+
+    dln = d;
+}
+
+void Timeout::update()
+{
+    auto const d { heap ? heap->time : none };
+
+    // Only reprogram the timer if the earliest deadline changed
+    if (d != dln)
+        program (d);
+}
+
+void Timeout::sync()
+{
+    program (heap ? heap->time : none);
 }
 
 uint64_t Timeout::idle()
 {
     // When called from Cpu::halt() there must always be at least one timeout pending
-    assert (list);
+    assert (heap);
 
-    auto const t { list->time };
+    auto const t { heap->time };
     auto const c { Timer::time() };
 
     return t > c ? Stc::ticks_to_us (t - c) : 0;
@@ -16,13 +16,25 @@
  */
 
 #include "acpi_table_srat.hpp"
+#include "buddy.hpp"
+#include "cpu.hpp"
+#include "lapic.hpp"
 #include "stdio.hpp"
 
+void Acpi_table_srat::affinity (apic_t a, uint32_t pxd)
+{
+    for (cpu_t c { 0 }; c < Cpu::count; c++)
+        if (Lapic::id[c] == a)
+            Cpu::node[c] = Numa::lookup (pxd);
+}
+
 void Acpi_table_srat::Affinity_lapic::parse() const
 {
     // Skip disabled entries
     if (EXPECT_FALSE (!(flags & BIT (0))))
         return;
+
+    affinity (id, pxd0 | pxd1 << 8 | pxd2 << 16 | pxd3 << 24);
 }
 
 void Acpi_table_srat::Affinity_x2apic::parse() const
@@ -30,6 +42,8 @@ void Acpi_table_srat::Affinity_x2apic::parse() const
     // Skip disabled entries
     if (EXPECT_FALSE (!(flags & BIT (0))))
         return;
+
+    affinity (id, pxd);
 }
 
 void Acpi_table_srat::Affinity_memory::parse() const
@@ -39,6 +53,8 @@ void Acpi_table_srat::Affinity_memory::parse() const
         return;
 
     trace (TRACE_FIRM, "SRAT: %#018lx-%018lx Dom %u", uint64_t { base }, base + size, uint32_t { pxd });
+
+    Numa::add_memory (base, size, pxd);
 }
 
 void Acpi_table_srat::parse() const
@@ -56,4 +72,7 @@ void Acpi_table_srat::parse() const
 
         ptr += a->length;
     }
+
+    // Partition the memory pool into per-node zones
+    Buddy::rezone();
 }
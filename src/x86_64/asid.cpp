@@ -0,0 +1,49 @@
+/*
+ * Address Space Identifier (ASID)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "asid.hpp"
+#include "svm.hpp"
+#include "util.hpp"
+
+uint64_t Asid::gen;
+uint16_t Asid::used;
+
+/*
+ * Assign a new ASID on this CPU
+ *
+ * The caller must flush the ASID before its first use, because it may
+ * still tag translations from an older generation.
+ *
+ * @param t     Tag (generation, CPU and ASID) to be updated
+ * @return      ASID
+ */
+uint16_t Asid::assign (uint64_t &t)
+{
+    // ASID 0 belongs to the host
+    auto const max { static_cast<uint16_t>(min (Vmcb::svm_asids, BIT (bits)) - 1) };
+
+    if (EXPECT_FALSE (used >= max)) {
+        gen  = gen + 1;
+        used = 0;
+    }
+
+    used = static_cast<uint16_t>(used + 1);
+
+    t = gen << 2 * bits | static_cast<uint64_t>(Cpu::id) << bits | used;
+
+    return used;
+}
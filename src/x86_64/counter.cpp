@@ -25,3 +25,9 @@ Counter Counter::req[NUM_IPI];
 Counter Counter::loc[NUM_LVT];
 Counter Counter::schedule;
 Counter Counter::helping;
+Counter Counter::xcall;
+Counter Counter::xcall_time;
+Counter Counter::buddy_hit;
+Counter Counter::buddy_lock;
+Counter Counter::buddy_remote;
+Counter Counter::buddy_zero;
@@ -203,9 +203,11 @@ void Cpu::enumerate_features (uint32_t &clk, uint32_t &rat, uint32_t (&lvl)[4],
             [[fallthrough]];
         case 0xd ... 0xf:
             cpuid (0xd, 0, eax, ebx, ecx, edx);
-            Fpu::hst_xsv.xcr = Fpu::managed & (static_cast<uint64_t>(edx) << 32 | eax);
+            Fpu::hst_xsv.xcr = (Fpu::managed | Fpu::tiles) & (static_cast<uint64_t>(edx) << 32 | eax);
             cpuid (0xd, 1, eax, ebx, ecx, edx);
             Fpu::hst_xsv.xss = Fpu::managed & (static_cast<uint64_t>(edx) << 32 | ecx);
+            if ((Fpu::hst_xsv.xcr & Fpu::tiles) != Fpu::tiles || !(eax & BIT (4)))   // AMX requires XFD
+                Fpu::hst_xsv.xcr &= ~Fpu::tiles;
             [[fallthrough]];
         case 0xb ... 0xc:
             if (topology == invalid_topology)
@@ -254,7 +256,7 @@ void Cpu::enumerate_features (uint32_t &clk, uint32_t &rat, uint32_t (&lvl)[4],
     if (eax & 0x80000000) {
         switch (static_cast<uint8_t>(eax)) {
             default:
-                cpuid (0x8000000a, Vmcb::svm_version, ebx, ecx, Vmcb::svm_feature);
+                cpuid (0x8000000a, Vmcb::svm_version, Vmcb::svm_asids, ecx, Vmcb::svm_feature);
                 [[fallthrough]];
             case 0x4 ... 0x9:
                 cpuid (0x80000004, name[8], name[9], name[10], name[11]);
@@ -412,6 +414,8 @@ void Cpu::init()
 
     Lapic::init (clk, rat);
 
+    Numa::node = node[id];
+
     if (!Acpi::resume) {
         Hpt::OAddr phys; unsigned o; Memattr ma;
         Space_hst::nova.loc[id] = Hptp::current();
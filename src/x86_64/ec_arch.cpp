@@ -16,11 +16,13 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "asid.hpp"
 #include "assert.hpp"
 #include "cpu.hpp"
 #include "ec_arch.hpp"
 #include "entry.hpp"
 #include "event.hpp"
+#include "exit_table.hpp"
 #include "fpu.hpp"
 #include "hip.hpp"
 #include "pd.hpp"
@@ -57,12 +59,14 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
 }
 
 // Constructor: GST EC (VMX)
-Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Vmcs *v, cpu_t c, unsigned long e, uintptr_t sp, uintptr_t hva, void *k) : Ec { t, f, ref_obj, ref_hst, v, k, c, e, set_vmm_regs_vmx }
+Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Vmcs *v, Vmcs_cache *vc, cpu_t c, unsigned long e, uintptr_t sp, uintptr_t hva, void *k, Exit_table *x) : Ec { t, f, ref_obj, ref_hst, v, k, c, e, set_vmm_regs_vmx }
 {
     auto const obj { regs.get_obj() };
     auto const hst { regs.get_hst() };
 
-    assert (obj && hst && v && k);
+    assert (obj && hst && v && vc && k);
+
+    regs.vmcs_cache = vc;
 
     trace (TRACE_CREATE, "EC:%p created (OBJ:%p HST:%p CPU:%u APIC:%p VMCS:%p %c)", static_cast<void *>(this), static_cast<void *>(obj), static_cast<void *>(hst), c, static_cast<void *>(k), static_cast<void *>(v), subtype == Kobject::Subtype::EC_VCPU_REAL  ? 'R' : 'O');
 
@@ -72,9 +76,10 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
     // FIXME: Allocation failure
     assert (hst->get_ptab (c));
 
-    auto const cr3 { Kmem::ptr_to_phys (hst->get_ptab (c)) | (Cpu::feature (Cpu::Feature::PCID) ? hst->get_pcid() : 0) };
+    // The PCID part is filled in on VM entry, because PCIDs are assigned lazily
+    auto const cr3 { Kmem::ptr_to_phys (hst->get_ptab (c)) };
 
-    v->init (sp, reinterpret_cast<uintptr_t>(&sys_regs() + 1), cr3, Kmem::ptr_to_phys (kpage), Vpid::alloc (cpu));
+    v->init (sp, reinterpret_cast<uintptr_t>(&sys_regs() + 1), cr3, Kmem::ptr_to_phys (kpage));
 
     assert (regs.vmcs == Vmcs::current);
 
@@ -98,6 +103,10 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
 
     // Map vAPIC page
     hst->update (hva, Kmem::ptr_to_phys (kpage), 0, Paging::Permissions (Paging::K | Paging::U | Paging::W | Paging::R), Memattr::ram());
+
+    // Map exit table page
+    if ((regs.xtab = x))
+        hst->update (hva + PAGE_SIZE (0), Kmem::ptr_to_phys (x), 0, Paging::Permissions (Paging::K | Paging::U | Paging::W | Paging::R), Memattr::ram());
 }
 
 // Constructor: GST EC (SVM)
@@ -110,9 +119,8 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
 
     trace (TRACE_CREATE, "EC:%p created (OBJ:%p HST:%p CPU:%u VMCB:%p %c)", static_cast<void *>(this), static_cast<void *>(obj), static_cast<void *>(hst), c, static_cast<void *>(v), subtype == Kobject::Subtype::EC_VCPU_REAL  ? 'R' : 'O');
 
-#if 0   // FIXME
-    regs.rax = Kmem::ptr_to_phys (regs.vmcb = new Vmcb (pd->Space_pio::walk(), pd->npt.init_root (false)));
-#endif
+    // VMLOAD/VMRUN/VMSAVE take the physical VMCB address in RAX, the guest RAX lives in the VMCB
+    sys_regs().rax = Kmem::ptr_to_phys (v);
 
     exc_regs().offset_tsc = 0;
     exc_regs().intcpt_cr0 = 0;
@@ -128,16 +136,23 @@ Ec_arch::Ec_arch (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst>
 }
 
 // Factory: GST EC
-Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t hva)
+Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, Fpu_mode fpm, bool xtb, bool vtm, bool hpl, cpu_t cpu, unsigned long evt, uintptr_t sp, uintptr_t hva)
 {
     auto const has_vmx { Hip::feature (Hip_arch::Feature::VMX) };
-    auto const has_svm { Hip::feature (Hip_arch::Feature::SVM) };
+    auto const has_svm { Hip::feature (Hip_arch::Feature::SVM) && *Kmem::loc_to_glob (cpu, &Vmcb::root) };
 
-    if (EXPECT_FALSE (!has_vmx && !has_svm)) {
+    // Exit tables are supported with VMX only, in-kernel virtual timers and halt polling not at all
+    if (EXPECT_FALSE ((!has_vmx && !has_svm) || (xtb && !has_vmx) || vtm || hpl)) {
         s = Status::BAD_FTR;
         return nullptr;
     }
 
+    // The exit table is mapped after the vAPIC page
+    if (EXPECT_FALSE (xtb && hva + PAGE_SIZE (0) >= Space_hst::selectors() << PAGE_BITS)) {
+        s = Status::BAD_PAR;
+        return nullptr;
+    }
+
     // Acquire references
     Refptr<Space_obj> ref_obj { pd->get_obj() };
     Refptr<Space_hst> ref_hst { pd->get_hst() };
@@ -149,27 +164,34 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     }
 
     auto const f { fpu ? new (pd->fpu_cache) Fpu : nullptr };
+    auto const n { Numa::remote (cpu) };
     Ec *ec;
 
     if (has_vmx) {
 
-        auto const v { new Vmcs };
-        auto const k { Buddy::alloc (0, Buddy::Fill::BITS0) };
+        auto const v { new (n) Vmcs };
+        auto const c { new Vmcs_cache };
+        auto const k { Buddy::alloc (0, Buddy::Fill::BITS0, n) };
+        auto const x { xtb ? new (n) Exit_table : nullptr };
 
-        if (EXPECT_TRUE ((!fpu || f) && v && k && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp, hva, k }))) {
+        if (EXPECT_TRUE ((!fpu || f) && v && c && k && (!xtb || x) && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, c, cpu, evt, sp, hva, k, x }))) {
             assert (!ref_obj && !ref_hst);
+            ec->fpm = fpm;
             return ec;
         }
 
+        delete x;
         Buddy::free (k);
+        delete c;
         delete v;
 
     } else if (has_svm) {
 
-        auto const v { new Vmcb };
+        auto const v { new (n) Vmcb };
 
         if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
             assert (!ref_obj && !ref_hst);
+            ec->fpm = fpm;
             return ec;
         }
 
@@ -245,11 +267,17 @@ void Ec::handle_hazard (unsigned h, cont_t func)
             regs.vmcs->make_current();
             Vmcs::write (Vmcs::Encoding::TSC_OFFSET, regs.exc.offset_tsc);
         } else
-            regs.vmcb->tsc_offset = regs.exc.offset_tsc;
+            regs.vmcb->update (regs.vmcb->tsc_offset, regs.exc.offset_tsc, Vmcb::CLEAN_I);
     }
 
-    if (EXPECT_FALSE (h & Hazard::FPU))
-        Cpu::hazard & Hazard::FPU ? Fpu::disable() : Fpu::enable();
+    if (EXPECT_FALSE (h & Hazard::FPU)) {
+        if (Cpu::hazard & Hazard::FPU)
+            Fpu::disable();
+        else {
+            Fpu::enable();
+            Fpu::arm_xfd (!regs.tiles);
+        }
+    }
 }
 
 void Ec_arch::ret_user_hypercall (Ec *const self)
@@ -286,8 +314,22 @@ void Ec_arch::ret_user_vmexit_vmx (Ec *const self)
 
     self->regs.vmcs->make_current();
 
+    // Assign a VPID if the vCPU has none from the current generation on this CPU
+    if (EXPECT_FALSE (Vmcs::has_vpid() && !Vpid::valid (self->regs.vpid)))
+        Vmcs::write (Vmcs::Encoding::VPID, Vpid::assign (self->regs.vpid));
+
+    // The host CR3 in the VMCS is stale if the host PCID was reassigned since the last VM entry
+    if (EXPECT_FALSE (self->regs.hcr3 != self->regs.get_hst()->tag (Cpu::id))) {
+        self->regs.hcr3 = self->regs.get_hst()->tag (Cpu::id);
+        Vmcs::write (Vmcs::Encoding::HOST_CR3, Cr::get_cr3());
+    }
+
     auto const gst { self->regs.get_gst() };
 
+    // Track CPUs that ever ran the space before checking for a pending shootdown
+    if (EXPECT_FALSE (!gst->cpus.tst (Cpu::id)))
+        gst->cpus.tas (Cpu::id);
+
     if (EXPECT_FALSE (gst->gtlb.tst (Cpu::id))) {
         gst->gtlb.clr (Cpu::id);
         gst->invalidate();
@@ -296,6 +338,8 @@ void Ec_arch::ret_user_vmexit_vmx (Ec *const self)
     if (EXPECT_FALSE (Cr::get_cr2() != self->exc_regs().cr2))
         Cr::set_cr2 (self->exc_regs().cr2);
 
+    save_tiles();
+
     Cpu::State_sys::make_current (Cpu::hst_sys, self->regs.gst_sys);    // Restore SYS guest state
     Cpu::State_tsc::make_current (Cpu::hst_tsc, self->regs.gst_tsc);    // Restore TSC guest state
     Fpu::State_xsv::make_current (Fpu::hst_xsv, self->regs.gst_xsv);    // Restore XSV guest state
@@ -317,13 +361,27 @@ void Ec_arch::ret_user_vmexit_svm (Ec *const self)
     if (EXPECT_FALSE (h))
         self->handle_hazard (h, ret_user_vmexit_svm);
 
+    auto const v { self->regs.vmcb };
+
+    // Assign an ASID if the vCPU has none from the current generation on this CPU
+    if (EXPECT_FALSE (!Asid::valid (self->regs.asid))) {
+        v->update (v->asid, Asid::assign (self->regs.asid), Vmcb::CLEAN_ASID);
+        v->tlb_control = Vmcb::tlb_flush_asid();
+    }
+
     auto const gst { self->regs.get_gst() };
 
+    // Track CPUs that ever ran the space before checking for a pending shootdown
+    if (EXPECT_FALSE (!gst->cpus.tst (Cpu::id)))
+        gst->cpus.tas (Cpu::id);
+
     if (EXPECT_FALSE (gst->gtlb.tst (Cpu::id))) {
         gst->gtlb.clr (Cpu::id);
-        self->regs.vmcb->tlb_control = 1;
+        v->tlb_control = 1;
     }
 
+    save_tiles();
+
     Cpu::State_tsc::make_current (Cpu::hst_tsc, self->regs.gst_tsc);    // Restore TSC guest state
     Fpu::State_xsv::make_current (Fpu::hst_xsv, self->regs.gst_xsv);    // Restore XSV guest state
 
@@ -33,7 +33,10 @@ void Ec::fpu_load()
     if (is_vcpu())
         regs.fpu_ctrl (true);
 
-    fpu->load();
+    // XRSTOR faults if XFD is armed for a requested component
+    Fpu::arm_xfd (!regs.tiles);
+
+    fpu->load (Fpu::managed | Fpu::tiles * regs.tiles);
 
     regs.hazard.set (Hazard::FPU);
 }
@@ -45,11 +48,79 @@ void Ec::fpu_save()
     if (is_vcpu())
         regs.fpu_ctrl (false);
 
-    fpu->save();
+    // XSAVE treats components with armed XFD as being in their initial configuration
+    if (regs.tiles)
+        Fpu::arm_xfd (false);
+
+    fpu->save (Fpu::managed | Fpu::tiles * regs.tiles);
+
+    // Tile state remains in registers, but is no longer live
+    if (regs.tiles)
+        Fpu::arm_xfd (true);
 
     regs.hazard.clr (Hazard::FPU);
 }
 
+Ec::~Ec()
+{
+    // A later FPU switch on that CPU would save into the XSAVE area of this EC
+    assert (*Kmem::loc_to_glob (cpu, &fpowner) != this);
+
+    // The extended XSAVE area is owned by the EC, whereas the original area came from the PD
+    if (regs.tiles)
+        Fpu::destroy_ext (fpu);
+
+    delete regs.vmcs_cache;
+}
+
+/*
+ * Handle AMX tile use with armed XFD
+ *
+ * On the first tile use, the XSAVE area of the EC is replaced with an
+ * extended area that includes AMX tile state. The live FPU state is
+ * written to the new area by the next save, so nothing is copied.
+ *
+ * @return      True if the EC may use AMX now, false otherwise
+ */
+bool Ec_arch::handle_exc_xfd()
+{
+    // The EC is not eligible to use the FPU
+    if (EXPECT_FALSE (!fpu))
+        return false;
+
+    // The EC already has an extended XSAVE area
+    if (regs.tiles) {
+
+        if (fpowner != this)
+            return switch_fpu (this);
+
+        Fpu::arm_xfd (false);
+
+        return true;
+    }
+
+    auto const f { Fpu::create_ext (Numa::remote (cpu)) };
+
+    if (EXPECT_FALSE (!f))
+        return false;
+
+    // Make the FPU state of this EC live
+    if (fpowner != this)
+        switch_fpu (this);
+
+    Fpu::operator delete (fpu, regs.get_hst()->get_pd()->fpu_cache);
+
+    fpu = f;
+    regs.tiles = true;
+
+    Fpu::arm_xfd (false);
+
+    // Tile registers may still hold the state of a previous owner
+    Fpu::release_tiles();
+
+    return true;
+}
+
 bool Ec_arch::handle_exc_gp (Exc_regs *)
 {
     if (Cpu::hazard & Hazard::TR) {
@@ -90,7 +161,7 @@ void Ec_arch::handle_exc (Exc_regs *r)
     switch (r->vec) {
 
         case EXC_NM:
-            if (switch_fpu (self))
+            if (Fpu::xfd_fault() ? static_cast<Ec_arch *>(self)->handle_exc_xfd() : switch_fpu (self))
                 return;
             break;
 
@@ -55,6 +55,8 @@ void Ec_arch::handle_svm()
     Cpu::State_tsc::make_current (self->regs.gst_tsc, Cpu::hst_tsc);    // Restore TSC host state
     Fpu::State_xsv::make_current (self->regs.gst_xsv, Fpu::hst_xsv);    // Restore XSV host state
 
+    // The VMCB and the state cached by the processor match after #VMEXIT
+    self->regs.vmcb->mark_clean();
     self->regs.vmcb->tlb_control = 0;
 
     auto reason { self->regs.vmcb->exitcode };
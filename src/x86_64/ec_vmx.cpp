@@ -21,6 +21,7 @@
 
 #include "counter.hpp"
 #include "ec_arch.hpp"
+#include "exit_table.hpp"
 #include "interrupt.hpp"
 #include "stdio.hpp"
 #include "vmx.hpp"
@@ -64,6 +65,77 @@ void Ec_arch::vmx_extint()
     ret_user_vmexit_vmx (this);
 }
 
+/*
+ * Resolve a VM exit in the kernel using the exit table of the vCPU
+ *
+ * @param reason    VM exit reason
+ * @return          true if resolved (guest RIP advanced), false if the VMM must handle the VM exit
+ */
+bool Ec_arch::vmx_resolve (unsigned reason)
+{
+    auto const xtab { regs.xtab };
+
+    // Single-stepping requires a #DB after the instruction, which is left to the VMM
+    if (!xtab || Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_RFLAGS) & RFL_TF)
+        return false;
+
+    auto &r { sys_regs() };
+
+    switch (reason) {
+
+        case Vmcs::VMX_CPUID:
+            if (auto const e { xtab->find_cpuid (static_cast<uint32_t>(r.rax), static_cast<uint32_t>(r.rcx)) }) {
+                r.rax = e->eax;
+                r.rbx = e->ebx;
+                r.rcx = e->ecx;
+                r.rdx = e->edx;
+                break;
+            }
+            return false;
+
+        case Vmcs::VMX_RDMSR:
+            if (auto const e { xtab->find_msr (static_cast<uint32_t>(r.rcx)) }) {
+                auto const v { e->val };
+                r.rax = static_cast<uint32_t>(v);
+                r.rdx = static_cast<uint32_t>(v >> 32);
+                break;
+            }
+            return false;
+
+        case Vmcs::VMX_WRMSR:
+            if (auto const e { xtab->find_msr (static_cast<uint32_t>(r.rcx)) }; e && e->flags & Exit_table::WRITE) {
+                auto const v { static_cast<uint64_t>(r.rdx) << 32 | static_cast<uint32_t>(r.rax) };
+                auto const o { e->val };
+                auto const m { e->msk };
+                if ((v ^ o) & ~m)
+                    return false;
+                e->val = v;
+                break;
+            }
+            return false;
+
+        case Vmcs::VMX_XSETBV:
+            if (!static_cast<uint32_t>(r.rcx)) {
+                auto const v { static_cast<uint64_t>(r.rdx) << 32 | static_cast<uint32_t>(r.rax) };
+                if (!xtab->permit_xcr0 (v) || Fpu::State_xsv::constrain_xcr (v) != v)
+                    return false;
+                regs.gst_xsv.xcr = v;
+                break;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+
+    Vmcs::write (Vmcs::Encoding::GUEST_RIP, Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_RIP) + Vmcs::read<uint32_t> (Vmcs::Encoding::EXI_INST_LEN));
+
+    // Emulating the instruction ends blocking by STI and by MOV SS
+    Vmcs::write (Vmcs::Encoding::GUEST_INTR_STATE, Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_INTR_STATE) & ~BIT_RANGE (1, 0));
+
+    return true;
+}
+
 void Ec_arch::handle_vmx()
 {
     Ec *const self { current };
@@ -79,9 +151,16 @@ void Ec_arch::handle_vmx()
 
     auto const reason { Vmcs::read<uint32_t> (Vmcs::Encoding::EXI_REASON) & BIT_RANGE (7, 0) };
 
+    // The guest may have changed guest-state fields
+    self->regs.vmcs_cache->invalidate (reason);
+
     switch (reason) {
         case Vmcs::VMX_EXC_NMI:     static_cast<Ec_arch *>(self)->vmx_exception();
         case Vmcs::VMX_EXTINT:      static_cast<Ec_arch *>(self)->vmx_extint();
+        case Vmcs::VMX_CPUID:
+        case Vmcs::VMX_RDMSR:
+        case Vmcs::VMX_WRMSR:
+        case Vmcs::VMX_XSETBV:      if (static_cast<Ec_arch *>(self)->vmx_resolve (reason)) ret_user_vmexit_vmx (self);
     }
 
     self->exc_regs().set_ep (reason);
@@ -22,12 +22,15 @@
  */
 
 #include "acpi.hpp"
+#include "bits.hpp"
+#include "buddy.hpp"
 #include "ec.hpp"
 #include "fpu.hpp"
 #include "stdio.hpp"
 #include "util.hpp"
 
 Fpu::State_xsv Fpu::hst_xsv;
+uint64_t       Fpu::xfd;
 
 void Fpu::init()
 {
@@ -38,8 +41,8 @@ void Fpu::init()
     if (compact)
         Msr::write (Msr::Reg64::IA32_XSS, hst_xsv.xss);
 
-    // Enable user state components in XCR0
-    Cr::set_xcr (0, hst_xsv.xcr);
+    // Enable user state components in XCR0, except AMX tile state
+    Cr::set_xcr (0, hst_xsv.xcr & ~tiles);
 
     if (!Acpi::resume) {
 
@@ -52,6 +55,51 @@ void Fpu::init()
 
         trace (TRACE_FPU, "FPU%c: State:%#lx Size:%u", compact ? 'C' : 'S', hst_xsv.xcr | hst_xsv.xss, size);
     }
+
+    if (!(hst_xsv.xcr & tiles))
+        return;
+
+    // Trap the first tile use of each EC, which then gets an extended XSAVE area
+    Msr::write (Msr::Reg64::IA32_XFD, xfd = tiles);
+
+    // Enable AMX tile state in XCR0
+    Cr::set_xcr (0, hst_xsv.xcr);
+
+    if (!Acpi::resume) {
+
+        // Determine context size including AMX tile state
+        uint32_t size, x;
+        Cpu::cpuid (0xd, compact, x, size, x, x);
+
+        // Use largest context size reported by any CPU
+        size_ext = max (size_ext, static_cast<size_t>(size));
+
+        trace (TRACE_FPU, "FPU%c: Tiles:%#lx Size:%u", compact ? 'C' : 'S', tiles, size);
+    }
+}
+
+/*
+ * Allocate extended XSAVE area
+ *
+ * @param node  Preferred NUMA node
+ * @return      Pointer to XSAVE area (allocation success) or nullptr (allocation failure)
+ */
+Fpu *Fpu::create_ext (Numa::node_t node)
+{
+    auto const ord { size_ext > PAGE_SIZE (0) ? bit_scan_msb (size_ext - 1) + 1 - PAGE_BITS : 0 };
+    auto const ptr { Buddy::alloc (static_cast<uint8_t>(ord), Buddy::Fill::BITS0, node) };
+
+    return ptr ? ::new (ptr) Fpu : nullptr;
+}
+
+/*
+ * Deallocate extended XSAVE area
+ *
+ * @param fpu   Pointer to XSAVE area (allocated by create_ext)
+ */
+void Fpu::destroy_ext (Fpu *fpu)
+{
+    Buddy::free (fpu);
 }
 
 void Fpu::fini()
@@ -58,8 +58,10 @@ void Interrupt::rke_handler()
     if (Acpi::get_transition().state())
         Cpu::hazard |= Hazard::SLEEP;
 
-    if (Space_hst::current->htlb.tst (Cpu::id))
+    if (Space_hst::current->stale (Cpu::id))
         Cpu::hazard |= Hazard::SCHED;
+
+    Tlb::acknowledge();
 }
 
 void Interrupt::handle_ipi (unsigned ipi)
@@ -71,6 +73,7 @@ void Interrupt::handle_ipi (unsigned ipi)
     switch (ipi) {
         case Request::RRQ: Scheduler::requeue(); break;
         case Request::RKE: rke_handler(); break;
+        case Request::RCL: Ec::handle_claims(); break;
     }
 }
 
@@ -172,6 +175,11 @@ void Interrupt::send_cpu (Request req, cpu_t cpu)
     Lapic::send_cpu (VEC_IPI + req, cpu);
 }
 
+void Interrupt::send_lgc (Request req, uint32_t ldr)
+{
+    Lapic::send_lgc (VEC_IPI + req, ldr);
+}
+
 void Interrupt::send_exc (Request req)
 {
     Lapic::send_exc (VEC_IPI + req);
@@ -34,6 +34,7 @@ void Patch::detect()
             Cpu::cpuid (0xd, 0x1, eax, ebx, ecx, edx);
             Fpu::compact = !!(eax & BIT (3));
             applied |= BIT (PATCH_XSAVES) * !Fpu::compact;
+            applied |= BIT (PATCH_XSAVEOPT) * (!Fpu::compact && !(eax & BIT (0)));
             [[fallthrough]];
         case 0x7 ... 0xc:
             Cpu::cpuid (0x7, 0x0, eax, ebx, ecx, edx);
@@ -26,15 +26,15 @@ void Cpu_regs::svm_set_cpu_pri (uint32_t val) const
 {
     unsigned const msk = !!msk_cr0<Vmcb>() << 0 | !!msk_cr4<Vmcb>() << 4;
 
-    vmcb->npt_control  = 1;
-    vmcb->intercept_cr = (msk << 16) | msk;
+    vmcb->update (vmcb->npt_control,  1,                 Vmcb::CLEAN_NP);
+    vmcb->update (vmcb->intercept_cr, (msk << 16) | msk, Vmcb::CLEAN_I);
 
-    vmcb->intercept_cpu[0] = val | Vmcb::force_ctrl0;
+    vmcb->update (vmcb->intercept_cpu[0], val | Vmcb::force_ctrl0, Vmcb::CLEAN_I);
 }
 
 void Cpu_regs::svm_set_cpu_sec (uint32_t val) const
 {
-    vmcb->intercept_cpu[1] = val | Vmcb::force_ctrl1;
+    vmcb->update (vmcb->intercept_cpu[1], val | Vmcb::force_ctrl1, Vmcb::CLEAN_I);
 }
 
 void Cpu_regs::vmx_set_cpu_pri (uint32_t val) const
@@ -43,12 +43,12 @@ void Cpu_regs::vmx_set_cpu_pri (uint32_t val) const
     if (!(val & Vmcs::CPU_TPR_SHADOW))
         val |= Vmcs::CPU_CR8_LOAD | Vmcs::CPU_CR8_STORE;
 
-    Vmcs::write (Vmcs::Encoding::CPU_CONTROLS_PRI, (val | Vmcs::cpu_pri_set) & Vmcs::cpu_pri_clr);
+    vmcs_cache->set_cpu_pri ((val | Vmcs::cpu_pri_set) & Vmcs::cpu_pri_clr);
 }
 
 void Cpu_regs::vmx_set_cpu_sec (uint32_t val) const
 {
-    Vmcs::write (Vmcs::Encoding::CPU_CONTROLS_SEC, (val | Vmcs::cpu_sec_set) & Vmcs::cpu_sec_clr);
+    vmcs_cache->set_cpu_sec ((val | Vmcs::cpu_sec_set) & Vmcs::cpu_sec_clr);
 }
 
 void Cpu_regs::vmx_set_cpu_ter (uint64_t val) const
@@ -30,7 +30,7 @@ Space_hst *Space_hst::current { nullptr };
 /*
  * Constructor (NOVA HST Space)
  */
-Space_hst::Space_hst() : Space_mem { Kobject::Subtype::HST }
+Space_hst::Space_hst() : Space_mem { Kobject::Subtype::HST }, tlbs { new Tlb_state }
 {
     Space_obj::nova.insert (Space_obj::Selector::NOVA_HST, Capability (this, std::to_underlying (Capability::Perm_sp::TAKE)));
 
@@ -57,3 +57,71 @@ void Space_hst::init (cpu_t cpu)
     // Share CPU-local memory
     loc[cpu].share_from (nova.loc[cpu], MMAP_CPU, MMAP_SPC);
 }
+
+/*
+ * Merge two pending TLB invalidations
+ *
+ * @param a     Pending invalidation
+ * @param b     Pending invalidation
+ * @return      Invalidation that covers both
+ */
+uint64_t Space_hst::merge (uint64_t a, uint64_t b)
+{
+    if (!a || !b)
+        return a | b;
+
+    if (a == tlb_full || b == tlb_full)
+        return tlb_full;
+
+    auto const s { min (a & ~OFFS_MASK (0), b & ~OFFS_MASK (0)) };
+    auto const e { max ((a & ~OFFS_MASK (0)) + (a & OFFS_MASK (0)) * PAGE_SIZE (0), (b & ~OFFS_MASK (0)) + (b & OFFS_MASK (0)) * PAGE_SIZE (0)) };
+    auto const n { (e - s) / PAGE_SIZE (0) };
+
+    return n <= BIT (tlb_ord) ? s | n : tlb_full;
+}
+
+/*
+ * Record a TLB invalidation for the CPUs that ran the space and shoot them down
+ *
+ * @param v     Virtual address of the range
+ * @param o     Order of the range (in pages)
+ */
+void Space_hst::sync (uint64_t v, unsigned o)
+{
+    auto const r { o <= tlb_ord ? v | BIT (o) : tlb_full };
+
+    for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++) {
+
+        // CPUs that never ran the space have nothing to invalidate
+        if (!cpus.tst (cpu))
+            continue;
+
+        uint64_t x { tlbs->inv[cpu] }, y;
+
+        do y = merge (x, r); while (!tlbs->inv[cpu].compare_exchange_n (x, y));
+    }
+
+    Tlb::shootdown (this, cpus);
+}
+
+/*
+ * Perform the pending TLB invalidation for the current CPU
+ *
+ * @return      True if the invalidation was page-selective, false if the PCID must be flushed
+ */
+bool Space_hst::invalidate()
+{
+    uint64_t r, n { 0 };
+
+    tlbs->inv[Cpu::id].exchange (r, n);
+
+    if (r == tlb_full || !Cpu::feature (Cpu::Feature::INVPCID))
+        return false;
+
+    auto const p { Cpu::feature (Cpu::Feature::PCID) ? Pcid::pcid (tlbs->pcid[Cpu::id]) : 0 };
+
+    for (auto a { r & ~OFFS_MASK (0) }, e { a + (r & OFFS_MASK (0)) * PAGE_SIZE (0) }; a < e; a += PAGE_SIZE (0))
+        Hptp::invalidate (p, a);
+
+    return true;
+}
@@ -20,6 +20,7 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "acpi.hpp"
 #include "arch.hpp"
 #include "cmdline.hpp"
 #include "cpu.hpp"
@@ -29,25 +30,42 @@
 #include "svm.hpp"
 
 uint64_t    Vmcb::root;
-unsigned    Vmcb::asid_ctr;
+uint64_t    Vmcb::hsave;
 uint32_t    Vmcb::svm_version;
+uint32_t    Vmcb::svm_asids;
 uint32_t    Vmcb::svm_feature;
 
-Vmcb::Vmcb (uintptr_t bmp, uintptr_t nptp) : base_io (bmp), asid (++asid_ctr), int_control (1ul << 24), npt_cr3 (nptp), efer (EFER_SVME), g_pat (0x7040600070406ull)
-{
-    base_msr = Kmem::ptr_to_phys (Buddy::alloc (1, Buddy::Fill::BITS1));
-    assert (base_msr);
-}
-
 void Vmcb::init()
 {
     if (!Cpu::feature (Cpu::Feature::SVM))
         return;
 
+    if (!Acpi::resume) {
+
+        // The host save area has a processor-specific layout, so the host VMLOAD/VMSAVE state lives in a separate VMCB
+        auto const h { Buddy::alloc (0, Buddy::Fill::BITS0) };
+        auto const r { new Vmcb };
+
+        // Without its VMCBs this CPU cannot run vCPUs, even if other CPUs advertise SVM
+        if (EXPECT_FALSE (!h || !r)) {
+            Buddy::free (h);
+            delete r;
+            return;
+        }
+
+        hsave = Kmem::ptr_to_phys (h);
+        root  = Kmem::ptr_to_phys (r);
+
+        Hip::set_feature (Hip_arch::Feature::SVM);
+    }
+
+    if (!root)
+        return;
+
     Msr::write (Msr::Reg64::IA32_EFER, Msr::read (Msr::Reg64::IA32_EFER) | EFER_SVME);
-    Msr::write (Msr::Reg64::AMD_SVM_HSAVE_PA, root = Kmem::ptr_to_phys (new Vmcb));
+    Msr::write (Msr::Reg64::AMD_SVM_HSAVE_PA, hsave);
 
-    trace (TRACE_VIRT, "VMCB: %#010lx REV:%#x NPT:%u", root, svm_version, has_npt());
+    asm volatile ("vmsave" : : "a" (root) : "memory");
 
-    Hip::set_feature (Hip_arch::Feature::SVM);
+    trace (TRACE_VIRT, "VMCB: %#010lx REV:%#x ASID:%u NPT:%u CLEAN:%u", root, svm_version, svm_asids, has_npt(), has_clean());
 }
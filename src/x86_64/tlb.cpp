@@ -19,9 +19,9 @@
  * GNU General Public License version 2 for more details.
  */
 
-#include "counter.hpp"
 #include "ec.hpp"
 #include "interrupt.hpp"
+#include "lapic.hpp"
 #include "space_gst.hpp"
 #include "space_hst.hpp"
 #include "stc.hpp"
@@ -29,12 +29,33 @@
 #include "tlb.hpp"
 #include "wait.hpp"
 
-void Tlb::shootdown (Space *s)
+uint64_t Tlb::ack;
+
+/*
+ * Shoot down stale TLB entries of a space on all CPUs that currently run it
+ *
+ * All IPIs are sent first and acknowledged together afterwards. CPUs in an
+ * x2APIC cluster are targeted with a single logical IPI.
+ *
+ * @param s     Space whose TLB entries became stale
+ * @param cpus  CPUs that ever ran the space
+ */
+void Tlb::shootdown (Space *s, Cpuset const &cpus)
 {
+    Cpuset pending;
+
+    uint32_t cls { 0 }, msk { 0 };
+
+    // A remote RKE handler that observes this generation has seen our page-table update
+    auto const g { ++gen };
+
     Cpu::preemption_enable();
 
     for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++) {
 
+        if (!cpus.tst (cpu))
+            continue;
+
         auto const ec { Ec::remote_current (cpu) };
 
         if (ec->regs.get_hst() != s && ec->regs.get_gst() != s)
@@ -45,12 +66,31 @@ void Tlb::shootdown (Space *s)
             continue;
         }
 
-        auto const c { Counter::req[Interrupt::Request::RKE].get (cpu) };
+        pending.tas (cpu);
+
+        if (!Lapic::x2apic) {
+            Interrupt::send_cpu (Interrupt::Request::RKE, cpu);
+            continue;
+        }
+
+        // Accumulate CPUs of the same x2APIC cluster into one logical IPI
+        auto const top { Cpu::remote_topology (cpu) };
 
-        Interrupt::send_cpu (Interrupt::Request::RKE, cpu);
+        if (msk && cls != top >> 4) {
+            Interrupt::send_lgc (Interrupt::Request::RKE, cls << 16 | msk);
+            msk = 0;
+        }
 
-        Wait::until (1, [&] { return Counter::req[Interrupt::Request::RKE].get (cpu) != c; });
+        cls  = top >> 4;
+        msk |= BIT (top & 0xf);
     }
 
+    if (msk)
+        Interrupt::send_lgc (Interrupt::Request::RKE, cls << 16 | msk);
+
+    for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++)
+        if (pending.tst (cpu))
+            Wait::until (1, [&] { return static_cast<int64_t>(*Kmem::loc_to_glob (cpu, &ack) - g) >= 0; });
+
     Cpu::preemption_disable();
 }
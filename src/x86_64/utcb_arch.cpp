@@ -85,9 +85,10 @@ bool Utcb_arch::save_exc (Mtd_arch const m, Exc_regs &e) const
     return true;
 }
 
-void Utcb_arch::load_vmx (Mtd_arch const m, Cpu_regs const &c)
+void Utcb_arch::load_vmx (Mtd_arch const m, Cpu_regs &c)
 {
     auto const &s { c.exc.sys };
+    auto &v { *c.vmcs_cache };
 
     c.vmcs->make_current();
 
@@ -137,48 +138,49 @@ void Utcb_arch::load_vmx (Mtd_arch const m, Cpu_regs const &c)
     }
 
     if (m & Mtd_arch::Item::CS_SS) {
-        cs.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_CS), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_CS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_CS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_CS));
-        ss.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_SS), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_SS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_SS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_SS));
+        cs = v.get_seg (Vmcs_cache::CS);
+        ss = v.get_seg (Vmcs_cache::SS);
     }
 
     if (m & Mtd_arch::Item::DS_ES) {
-        ds.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_DS), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_DS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_DS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_DS));
-        es.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_ES), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_ES), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_ES), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_ES));
+        ds = v.get_seg (Vmcs_cache::DS);
+        es = v.get_seg (Vmcs_cache::ES);
     }
 
     if (m & Mtd_arch::Item::FS_GS) {
-        fs.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_FS), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_FS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_FS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_FS));
-        gs.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_GS), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_GS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_GS), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_GS));
+        fs = v.get_seg (Vmcs_cache::FS);
+        gs = v.get_seg (Vmcs_cache::GS);
     }
 
     if (m & Mtd_arch::Item::TR)
-        tr.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_TR), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_TR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_TR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_TR));
+        tr = v.get_seg (Vmcs_cache::TR);
 
     if (m & Mtd_arch::Item::LDTR)
-        ld.set_vmx (Vmcs::read<uint16_t> (Vmcs::Encoding::GUEST_SEL_LDTR), Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_LDTR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_LDTR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_AR_LDTR));
+        ld = v.get_seg (Vmcs_cache::LDTR);
 
     if (m & Mtd_arch::Item::GDTR)
-        gd.set_vmx (0, Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_GDTR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_GDTR), 0);
+        gd = v.get_seg (Vmcs_cache::GDTR);
 
     if (m & Mtd_arch::Item::IDTR)
-        id.set_vmx (0, Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_BASE_IDTR), Vmcs::read<uint32_t> (Vmcs::Encoding::GUEST_LIMIT_IDTR), 0);
+        id = v.get_seg (Vmcs_cache::IDTR);
 
     if (m & Mtd_arch::Item::PDPTE) {
-        pdpte[0] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE0);
-        pdpte[1] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE1);
-        pdpte[2] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE2);
-        pdpte[3] = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PDPTE3);
+        auto const p { v.get_pdpte() };
+        pdpte[0] = p[0];
+        pdpte[1] = p[1];
+        pdpte[2] = p[2];
+        pdpte[3] = p[3];
     }
 
     if (m & Mtd_arch::Item::CR) {
         cr0 = c.vmx_get_gst_cr0();
         cr4 = c.vmx_get_gst_cr4();
         cr2 = c.exc.cr2;
-        cr3 = Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_CR3);
+        cr3 = v.get_cr3();
     }
 
     if (m & Mtd_arch::Item::DR)
-        dr7 = Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_DR7);
+        dr7 = v.get_dr7();
 
     if (m & Mtd_arch::Item::XSAVE) {
         xcr0 = c.gst_xsv.xcr;
@@ -191,17 +193,14 @@ void Utcb_arch::load_vmx (Mtd_arch const m, Cpu_regs const &c)
         fmask = c.gst_sys.fmask;
     }
 
-    if (m & Mtd_arch::Item::SYSENTER) {
-        sysenter_cs  = Vmcs::read<uint32_t>  (Vmcs::Encoding::GUEST_SYSENTER_CS);
-        sysenter_esp = Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_SYSENTER_ESP);
-        sysenter_eip = Vmcs::read<uintptr_t> (Vmcs::Encoding::GUEST_SYSENTER_EIP);
-    }
+    if (m & Mtd_arch::Item::SYSENTER)
+        v.get_sysenter (sysenter_cs, sysenter_esp, sysenter_eip);
 
     if (m & Mtd_arch::Item::PAT)
-        pat = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_PAT);
+        pat = v.get_pat();
 
     if (m & Mtd_arch::Item::EFER)
-        efer = Vmcs::read<uint64_t> (Vmcs::Encoding::GUEST_EFER);
+        efer = v.get_efer();
 
     if (m & Mtd_arch::Item::KERNEL_GS_BASE)
         kernel_gs_base = c.gst_sys.kernel_gs_base;
@@ -213,6 +212,7 @@ void Utcb_arch::load_vmx (Mtd_arch const m, Cpu_regs const &c)
 bool Utcb_arch::save_vmx (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) const
 {
     auto &s { c.exc.sys };
+    auto &v { *c.vmcs_cache };
 
     c.vmcs->make_current();
 
@@ -270,16 +270,15 @@ bool Utcb_arch::save_vmx (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
         c.vmx_set_cpu_sec (ctrl_sec);
         c.vmx_set_cpu_ter (ctrl_ter);
 
-        Vmcs::write (Vmcs::Encoding::PF_ERROR_MASK,  pfe_mask);
-        Vmcs::write (Vmcs::Encoding::PF_ERROR_MATCH, pfe_match);
+        v.set_pfe (pfe_mask, pfe_match);
     }
 
     if (m & Mtd_arch::Item::TPR)
-        Vmcs::write (Vmcs::Encoding::TPR_THRESHOLD, tpr_threshold);
+        v.set_tpr (tpr_threshold);
 
     if (m & Mtd_arch::Item::INJ) {
 
-        auto val { Vmcs::read<uint32_t> (Vmcs::Encoding::CPU_CONTROLS_PRI) };
+        auto val { v.get_cpu_pri() };
 
         if (intr_info & 0x1000)
             val |=  Vmcs::CPU_INTR_WINDOW;
@@ -298,78 +297,44 @@ bool Utcb_arch::save_vmx (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
     }
 
     if (m & Mtd_arch::Item::CS_SS) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_CS,   cs.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_CS,  cs.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_CS, cs.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_CS,   (cs.ar << 4 & 0x1f000) | (cs.ar & 0xff));
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_SS,   ss.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_SS,  ss.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_SS, ss.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_SS,   (ss.ar << 4 & 0x1f000) | (ss.ar & 0xff));
+        v.set_seg (Vmcs_cache::CS, cs);
+        v.set_seg (Vmcs_cache::SS, ss);
     }
 
     if (m & Mtd_arch::Item::DS_ES) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_DS,   ds.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_DS,  ds.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_DS, ds.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_DS,   (ds.ar << 4 & 0x1f000) | (ds.ar & 0xff));
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_ES,   es.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_ES,  es.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_ES, es.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_ES,   (es.ar << 4 & 0x1f000) | (es.ar & 0xff));
+        v.set_seg (Vmcs_cache::DS, ds);
+        v.set_seg (Vmcs_cache::ES, es);
     }
 
     if (m & Mtd_arch::Item::FS_GS) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_FS,   fs.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_FS,  fs.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_FS, fs.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_FS,   (fs.ar << 4 & 0x1f000) | (fs.ar & 0xff));
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_GS,   gs.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_GS,  gs.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_GS, gs.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_GS,   (gs.ar << 4 & 0x1f000) | (gs.ar & 0xff));
+        v.set_seg (Vmcs_cache::FS, fs);
+        v.set_seg (Vmcs_cache::GS, gs);
     }
 
-    if (m & Mtd_arch::Item::TR) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_TR,   tr.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_TR,  tr.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_TR, tr.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_TR,   (tr.ar << 4 & 0x1f000) | (tr.ar & 0xff));
-    }
+    if (m & Mtd_arch::Item::TR)
+        v.set_seg (Vmcs_cache::TR, tr);
 
-    if (m & Mtd_arch::Item::LDTR) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SEL_LDTR,   ld.sel);
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_LDTR,  ld.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_LDTR, ld.limit);
-        Vmcs::write (Vmcs::Encoding::GUEST_AR_LDTR,   (ld.ar << 4 & 0x1f000) | (ld.ar & 0xff));
-    }
+    if (m & Mtd_arch::Item::LDTR)
+        v.set_seg (Vmcs_cache::LDTR, ld);
 
-    if (m & Mtd_arch::Item::GDTR) {
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_GDTR,  gd.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_GDTR, gd.limit);
-    }
+    if (m & Mtd_arch::Item::GDTR)
+        v.set_seg (Vmcs_cache::GDTR, gd);
 
-    if (m & Mtd_arch::Item::IDTR) {
-        Vmcs::write (Vmcs::Encoding::GUEST_BASE_IDTR,  id.base);
-        Vmcs::write (Vmcs::Encoding::GUEST_LIMIT_IDTR, id.limit);
-    }
+    if (m & Mtd_arch::Item::IDTR)
+        v.set_seg (Vmcs_cache::IDTR, id);
 
-    if (m & Mtd_arch::Item::PDPTE) {
-        Vmcs::write (Vmcs::Encoding::GUEST_PDPTE0, pdpte[0]);
-        Vmcs::write (Vmcs::Encoding::GUEST_PDPTE1, pdpte[1]);
-        Vmcs::write (Vmcs::Encoding::GUEST_PDPTE2, pdpte[2]);
-        Vmcs::write (Vmcs::Encoding::GUEST_PDPTE3, pdpte[3]);
-    }
+    if (m & Mtd_arch::Item::PDPTE)
+        v.set_pdpte (pdpte);
 
     if (m & Mtd_arch::Item::CR) {
         c.vmx_set_gst_cr0 (cr0);
         c.vmx_set_gst_cr4 (cr4);
         c.exc.cr2 = cr2;
-        Vmcs::write (Vmcs::Encoding::GUEST_CR3, cr3);
+        v.set_cr3 (cr3);
     }
 
     if (m & Mtd_arch::Item::DR)
-        Vmcs::write (Vmcs::Encoding::GUEST_DR7, dr7);
+        v.set_dr7 (dr7);
 
     if (m & Mtd_arch::Item::XSAVE) {
         c.gst_xsv.xcr = Fpu::State_xsv::constrain_xcr (xcr0);
@@ -382,18 +347,14 @@ bool Utcb_arch::save_vmx (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
         c.gst_sys.fmask = Cpu::State_sys::constrain_fmask (fmask);
     }
 
-    if (m & Mtd_arch::Item::SYSENTER) {
-        Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_CS,  sysenter_cs);
-        Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_ESP, sysenter_esp);
-        Vmcs::write (Vmcs::Encoding::GUEST_SYSENTER_EIP, sysenter_eip);
-    }
+    if (m & Mtd_arch::Item::SYSENTER)
+        v.set_sysenter (sysenter_cs, sysenter_esp, sysenter_eip);
 
     if (m & Mtd_arch::Item::PAT)
-        Vmcs::write (Vmcs::Encoding::GUEST_PAT, pat);
-
-    if (m & Mtd_arch::Item::EFER) {
+        v.set_pat (pat);
 
-        Vmcs::write (Vmcs::Encoding::GUEST_EFER, efer);
+    // The IA-32e mode guest control only needs an update if EFER changed
+    if (m & Mtd_arch::Item::EFER && v.set_efer (efer)) {
 
         auto ent { Vmcs::read<uint32_t> (Vmcs::Encoding::ENT_CONTROLS) };
 
@@ -549,7 +510,7 @@ void Utcb_arch::load_svm (Mtd_arch const m, Cpu_regs const &c)
         pat = v->g_pat;
 
     if (m & Mtd_arch::Item::EFER)
-        efer = v->efer;
+        efer = v->efer & ~EFER_SVME;
 
     if (m & Mtd_arch::Item::KERNEL_GS_BASE)
         kernel_gs_base = v->kernel_gs_base;
@@ -601,24 +562,25 @@ bool Utcb_arch::save_svm (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
     if (m & Mtd_arch::Item::INJ) {
 
         if (intr_info & 0x1000) {
-            v->int_control      |=  (1ul << 8 | 1ul << 20);
-            v->intercept_cpu[0] |=  Vmcb::CPU_VINTR;
+            v->update (v->int_control,      v->int_control      |  (1ul << 8 | 1ul << 20), Vmcb::CLEAN_TPR);
+            v->update (v->intercept_cpu[0], v->intercept_cpu[0] |  Vmcb::CPU_VINTR,        Vmcb::CLEAN_I);
         } else {
-            v->int_control      &= ~(1ul << 8 | 1ul << 20);
-            v->intercept_cpu[0] &= ~Vmcb::CPU_VINTR;
+            v->update (v->int_control,      v->int_control      & ~(1ul << 8 | 1ul << 20), Vmcb::CLEAN_TPR);
+            v->update (v->intercept_cpu[0], v->intercept_cpu[0] & ~Vmcb::CPU_VINTR,        Vmcb::CLEAN_I);
         }
 
         v->inj_control = static_cast<uint64_t>(intr_errc) << 32 | (intr_info & ~0x3000);
     }
 
     if (m & Mtd_arch::Item::CS_SS) {
-        v->cs = cs;
-        v->ss = ss;
+        v->update (v->cs, cs, Vmcb::CLEAN_SEG);
+        v->update (v->ss, ss, Vmcb::CLEAN_SEG);
+        v->update (v->cpl, static_cast<uint8_t>(ss.ar >> 5 & 3), Vmcb::CLEAN_SEG);
     }
 
     if (m & Mtd_arch::Item::DS_ES) {
-        v->ds = ds;
-        v->es = es;
+        v->update (v->ds, ds, Vmcb::CLEAN_SEG);
+        v->update (v->es, es, Vmcb::CLEAN_SEG);
     }
 
     if (m & Mtd_arch::Item::FS_GS) {
@@ -633,22 +595,22 @@ bool Utcb_arch::save_svm (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
         v->ldtr = ld;
 
     if (m & Mtd_arch::Item::GDTR)
-        v->gdtr = gd;
+        v->update (v->gdtr, gd, Vmcb::CLEAN_DT);
 
     if (m & Mtd_arch::Item::IDTR)
-        v->idtr = id;
+        v->update (v->idtr, id, Vmcb::CLEAN_DT);
 
     // PDPTE registers are not used
 
     if (m & Mtd_arch::Item::CR) {
-        v->cr0 = cr0;
-        v->cr2 = cr2;
-        v->cr3 = cr3;
-        v->cr4 = cr4;
+        v->update (v->cr0, cr0, Vmcb::CLEAN_CRX);
+        v->update (v->cr2, cr2, Vmcb::CLEAN_CR2);
+        v->update (v->cr3, cr3, Vmcb::CLEAN_CRX);
+        v->update (v->cr4, cr4, Vmcb::CLEAN_CRX);
     }
 
     if (m & Mtd_arch::Item::DR)
-        v->dr7 = dr7;
+        v->update (v->dr7, dr7, Vmcb::CLEAN_DRX);
 
     if (m & Mtd_arch::Item::XSAVE) {
         c.gst_xsv.xcr = Fpu::State_xsv::constrain_xcr (xcr0);
@@ -668,10 +630,11 @@ bool Utcb_arch::save_svm (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
     }
 
     if (m & Mtd_arch::Item::PAT)
-        v->g_pat = pat;
+        v->update (v->g_pat, pat, Vmcb::CLEAN_NP);
 
+    // VMRUN requires EFER.SVME in the guest
     if (m & Mtd_arch::Item::EFER)
-        v->efer = efer;
+        v->update (v->efer, efer | EFER_SVME, Vmcb::CLEAN_CRX);
 
     if (m & Mtd_arch::Item::KERNEL_GS_BASE)
         v->kernel_gs_base = Cpu::State_sys::constrain_canon (kernel_gs_base);
@@ -681,16 +644,16 @@ bool Utcb_arch::save_svm (Mtd_arch const m, Cpu_regs &c, Space_obj const *obj) c
 
     if (m & Mtd_arch::Item::TLB)
         if (v->asid)
-            v->tlb_control = 3;
+            v->tlb_control = Vmcb::tlb_flush_asid();
 
     if (m & Mtd_arch::Item::SPACES) {
 
         if (EXPECT_FALSE (!assign_spaces (c, obj)))
             return false;
 
-        v->npt_cr3  = c.gst->get_phys();
-        v->base_io  = c.pio->get_phys();
-        v->base_msr = c.msr->get_phys();
+        v->update (v->npt_cr3,  c.gst->get_phys(), Vmcb::CLEAN_NP);
+        v->update (v->base_io,  c.pio->get_phys(), Vmcb::CLEAN_IOPM);
+        v->update (v->base_msr, c.msr->get_phys(), Vmcb::CLEAN_IOPM);
     }
 
     return true;
@@ -33,8 +33,11 @@
 #include "stdio.hpp"
 #include "tss.hpp"
 #include "util.hpp"
+#include "vmcs_cache.hpp"
 #include "vmx.hpp"
 
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Vmcs_cache::cache { sizeof (Vmcs_cache), alignof (Vmcs_cache) };
+
 Vmcs *      Vmcs::root        { nullptr };
 Vmcs *      Vmcs::current     { nullptr };
 uint64_t    Vmcs::basic       { 0 };
@@ -49,7 +52,7 @@ uint64_t    Vmcs::cpu_ter_clr { 0 }, Vmcs::cpu_ter_set { 0 };
 uintptr_t   Vmcs::fix_cr0_clr { 0 }, Vmcs::fix_cr0_set { 0 };
 uintptr_t   Vmcs::fix_cr4_clr { 0 }, Vmcs::fix_cr4_set { 0 };
 
-void Vmcs::init (uintptr_t gsp, uintptr_t hsp, uintptr_t cr3, uint64_t apic, uint16_t vpid)
+void Vmcs::init (uintptr_t gsp, uintptr_t hsp, uintptr_t cr3, uint64_t apic)
 {
     // Set VMCS launch state to "clear" and initialize implementation-specific VMCS state.
     clear();
@@ -83,7 +86,6 @@ void Vmcs::init (uintptr_t gsp, uintptr_t hsp, uintptr_t cr3, uint64_t apic, uin
     write (Encoding::APIC_PAGE_ADDR, apic);
     write (Encoding::APIC_ACCS_ADDR, Kmem::ptr_to_phys (this));
     write (Encoding::VMCS_LINK_PTR, ~0ULL);
-    write (Encoding::VPID, vpid);
 
     write (Encoding::HOST_SEL_CS, SEL_KERN_CODE);
     write (Encoding::HOST_SEL_SS, SEL_KERN_DATA);
@@ -18,6 +18,31 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "vmx.hpp"
 #include "vpid.hpp"
 
-Atomic<uint16_t> Vpid::allocator { 0 };
+uint64_t Vpid::gen;
+uint16_t Vpid::used;
+
+/*
+ * Assign a new VPID on this CPU
+ *
+ * @param t     Tag (generation, CPU and VPID) to be updated
+ * @return      VPID
+ */
+uint16_t Vpid::assign (uint64_t &t)
+{
+    if (EXPECT_FALSE (used == BIT (bits) - 1)) {
+        gen  = gen + 1;
+        used = 0;
+    }
+
+    used = static_cast<uint16_t>(used + 1);
+
+    t = gen << 2 * bits | static_cast<uint64_t>(Cpu::id) << bits | used;
+
+    // The VPID may still tag translations from an older generation
+    invalidate (Vmcs::has_invvpid_sgl() ? Invvpid::Type::SGL : Invvpid::Type::ALL, used);
+
+    return used;
+}